@@ -0,0 +1,153 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+
+namespace Pixtro.Compiler {
+	// Turns the collision shapes in a visual pack into the profile tables the engine's physics reads
+	public static class CollisionShapes {
+
+		public const int ShapeCount = 15;
+
+		// Builds which pixels of a block are solid from a shape's definition.  Either one of the preset names, or a
+		// list of heights for each column (from the bottom), starting with "ceiling:" to go down from the top instead
+		private static bool[,] GetMask(string shape, int size) {
+			bool[,] mask = new bool[size, size];
+
+			int[] heights = new int[size];
+			bool ceiling = false;
+
+			switch (shape.Trim().ToLower()) {
+				case "full":
+					for (int x = 0; x < size; ++x)
+						heights[x] = size;
+					break;
+				case "halfbottom":
+					for (int x = 0; x < size; ++x)
+						heights[x] = size / 2;
+					break;
+				case "halftop":
+					ceiling = true;
+					for (int x = 0; x < size; ++x)
+						heights[x] = size / 2;
+					break;
+				case "halfleft":
+					for (int x = 0; x < size / 2; ++x)
+						heights[x] = size;
+					break;
+				case "halfright":
+					for (int x = size / 2; x < size; ++x)
+						heights[x] = size;
+					break;
+				case "slopeup":
+					for (int x = 0; x < size; ++x)
+						heights[x] = x + 1;
+					break;
+				case "slopedown":
+					for (int x = 0; x < size; ++x)
+						heights[x] = size - x;
+					break;
+				case "slopeuplow":
+					for (int x = 0; x < size; ++x)
+						heights[x] = (x + 2) / 2;
+					break;
+				case "slopeuphigh":
+					for (int x = 0; x < size; ++x)
+						heights[x] = (size / 2) + ((x + 2) / 2);
+					break;
+				case "slopedownhigh":
+					for (int x = 0; x < size; ++x)
+						heights[x] = size - (x / 2);
+					break;
+				case "slopedownlow":
+					for (int x = 0; x < size; ++x)
+						heights[x] = (size / 2) - (x / 2);
+					break;
+				case "ceilingslopeup":
+					ceiling = true;
+					for (int x = 0; x < size; ++x)
+						heights[x] = size - x;
+					break;
+				case "ceilingslopedown":
+					ceiling = true;
+					for (int x = 0; x < size; ++x)
+						heights[x] = x + 1;
+					break;
+				default: {
+					string list = shape;
+
+					if (list.Trim().ToLower().StartsWith("ceiling:")) {
+						ceiling = true;
+						list = list.Substring(list.IndexOf(':') + 1);
+					}
+
+					string[] split = list.Split(new char[] { ',' }, StringSplitOptions.RemoveEmptyEntries);
+
+					if (split.Length != size)
+						throw new FormatException($"Collision shape \"{shape}\" needs {size} heights, one for each column.");
+
+					for (int x = 0; x < size; ++x)
+						heights[x] = Math.Clamp(int.Parse(split[x].Trim()), 0, size);
+					break;
+				}
+			}
+
+			for (int x = 0; x < size; ++x) {
+				for (int y = 0; y < heights[x]; ++y) {
+					mask[x, ceiling ? y : size - 1 - y] = true;
+				}
+			}
+
+			return mask;
+		}
+
+		// Each shape is the top and bottom of each column, then the left and right of each row.
+		// Slopes leave out the rows, so the engine only pushes entities onto them vertically
+		public static byte[] Compile(Dictionary<int, string> shapes, int size) {
+			byte[] retval = new byte[ShapeCount * size * 4];
+
+			if (shapes == null)
+				return retval;
+
+			foreach (var pair in shapes) {
+				if (pair.Key < 1 || pair.Key > ShapeCount) {
+					MainProgram.WarningLog($"Collision shape {pair.Key} is out of range.  Shapes go from 1 to {ShapeCount}.");
+					continue;
+				}
+
+				bool[,] mask = GetMask(pair.Value, size);
+				int offset = (pair.Key - 1) * size * 4;
+
+				int[] top = new int[size], bottom = new int[size];
+
+				for (int x = 0; x < size; ++x) {
+					for (int y = 0; y < size; ++y) {
+						if (!mask[x, y])
+							continue;
+
+						if (bottom[x] == 0)
+							top[x] = y;
+						bottom[x] = y + 1;
+					}
+
+					retval[offset + x] = (byte)top[x];
+					retval[offset + size + x] = (byte)bottom[x];
+				}
+
+				// The shape's a rectangle if the columns with anything in them are next to each other, and all the same
+				var filled = Enumerable.Range(0, size).Where(x => bottom[x] > 0).ToArray();
+
+				if (filled.Length == 0 || filled.Last() - filled.First() + 1 != filled.Length ||
+					filled.Any(x => top[x] != top[filled[0]] || bottom[x] != bottom[filled[0]]))
+					continue;
+
+				for (int y = top[filled[0]]; y < bottom[filled[0]]; ++y) {
+					retval[offset + size * 2 + y] = (byte)filled.First();
+					retval[offset + size * 3 + y] = (byte)(filled.Last() + 1);
+				}
+			}
+
+			return retval;
+		}
+	}
+}
@@ -105,6 +105,9 @@ namespace Pixtro.Compiler {
 		}
 		public Dictionary<char, TileWrapping> Wrapping;
 
+		// The collision shapes used by CollisionShape, from 1 to 15.  Either a preset name, or each column's height
+		public Dictionary<int, string> Shapes;
+
 
 		[JsonIgnore]
 		public LevelBrickset fullTileset = null;
@@ -155,6 +158,35 @@ namespace Pixtro.Compiler {
 
 		public ushort GetIndex(LargeTile tile, char type) => GetIndex(GetBrick(tile, type));
 
+		// Each brick's raw tiles as screenblock entries (tile index and flip), row by row.  Raw tiles start at 1 in vram
+		public ushort[] GetScreenEntries(Brick brick)
+		{
+			if (screenEntries.TryGetValue(brick, out ushort[] entries))
+				return entries;
+
+			int size = Settings.BrickTileSize;
+			entries = new ushort[size * size];
+
+			for (int i = 0; i < size * size; ++i)
+			{
+				var brickTile = brick.tiles[i % size, i / size];
+
+				foreach (var rt in rawTiles)
+				{
+					if (brickTile.EqualTo(rt, FlipStyle.Both))
+					{
+						entries[i] = (ushort)(rawTiles.IndexOf(rt, new CompareFlippable<Tile>()) + 1);
+						entries[i] |= (ushort)(brickTile.GetFlipOffset(rt) << 10);
+						break;
+					}
+				}
+			}
+
+			screenEntries.Add(brick, entries);
+			return entries;
+		}
+		Dictionary<Brick, ushort[]> screenEntries = new Dictionary<Brick, ushort[]>();
+
 		public ushort GetIndex(Brick brick)
 		{
 			return (ushort)bricks.IndexOf(brick);
@@ -389,6 +421,12 @@ namespace Pixtro.Compiler {
 			}
 		}
 
+		// The engine decompresses whole levels, collision grid included, into 64KB of EWRAM.  Anything bigger is split
+		// into chunks of 16x16 tiles, which have to match CHUNK_SHIFT in the engine.  Chunks are loaded into the first 48KB,
+		// and the collision grid is never split so it has to fit in the last 16KB.  The engine can track up to ChunkLimit
+		// chunks in a level (CHUNK_TABLE_LEN)
+		private const int LoadAreaSize = 0x10000, ChunkAreaSize = 0xC000, ChunkTiles = 16, ChunkLimit = 0x2000;
+
 		public byte[] BinaryData() {
 			List<byte> bytes = new List<byte>(Enumerable.ToArray(GetBinary()));
 
@@ -398,55 +436,140 @@ namespace Pixtro.Compiler {
 			return bytes.ToArray();
 		}
 		private IEnumerable<byte> GetBinary() {
-			foreach (var b in Header())
-				yield return b;
+			List<byte> bytes = new List<byte>();
+
+			// Collision is taken from the first layer, so the visual layers need to be compiled before it
+			List<ushort[]> visuals = new List<ushort[]>();
+
+			for (int i = 0; i < layers; ++i)
+				visuals.Add(VisualLayer(i));
+
+			// Levels too big for the engine to decompress all at once get split into chunks.  Sizes are rounded up to 4
+			// bytes, the same as the engine does
+			int size = Settings.BrickTileSize;
+			int mapWidth = width * size, mapHeight = height * size;
+			int visualSize = (layers * mapWidth * mapHeight * 2 + 3) & ~0x3, gridSize = ((width + 2) * (height + 2) + 3) & ~0x3;
+			bool chunked = visualSize + gridSize > LoadAreaSize;
+
+			if (chunked && gridSize > LoadAreaSize - ChunkAreaSize) {
+				MainProgram.ErrorLog($"Level is too large to load, its collision grid of {width + 2}x{height + 2} blocks is over 16KB.");
+				return new byte[0];
+			}
+
+			bytes.AddRange(Header(chunked));
 
 			if ((metadata.Count & 0x1) == 1)
 			{
-				yield return 3;
-				yield return 0xFF;
-				yield return 0xFF;
+				bytes.Add(3);
+				bytes.Add(0xFF);
+				bytes.Add(0xFF);
 			}
 			else
 			{
-				yield return 1;
+				bytes.Add(1);
 			}
 
-			for (int i = 0; i < layers; ++i) {
+			// The collision grid comes first.  After that is either each visual layer, or the table of chunk offsets
+			List<byte[]> sections = new List<byte[]>();
+
+			sections.Add(CollisionLayer());
+
+			int chunksX = (mapWidth + ChunkTiles - 1) / ChunkTiles, chunksY = (mapHeight + ChunkTiles - 1) / ChunkTiles;
+			int chunkCount = layers * chunksX * chunksY, chunkTable = 0;
 
-				var array = VisualLayer(i);
+			if (chunked) {
+				if (chunkCount > ChunkLimit) {
+					MainProgram.ErrorLog($"Level is too large to load, it has {chunkCount} chunks when the limit is {ChunkLimit}.");
+					return new byte[0];
+				}
+
+				sections.Add(new byte[chunkCount * 4]);
+			}
+			else {
+				foreach (var layer in visuals)
+					sections.Add(LZUtil.Compress(EntryBytes(layer)));
+			}
+
+			for (int i = 0; i < sections.Count; ++i) {
+
+				var array = sections[i];
 				int len = array.Length;
 				int offset = 4 - ((array.Length + 3) & 0x3);
-				if (i == layers - 1)
+				if (i == sections.Count - 1)
 					offset = 0;
 				len += offset;
 
-				yield return (byte)(len & 0xFF);
-				yield return (byte)(len >> 8);
+				bytes.Add((byte)(len & 0xFF));
+				bytes.Add((byte)(len >> 8));
 
-				foreach (var b in array) {
-					yield return b;
-				}
+				if (chunked && i == 1)
+					chunkTable = bytes.Count;
 
+				bytes.AddRange(array);
 
-				if (i == layers - 1)
+				if (i == sections.Count - 1)
 					break;
 
 				for (int j = 0; j < offset; ++j) {
-					yield return 0xFF;
+					bytes.Add(0xFF);
 				}
 
-				yield return 0x01;
+				bytes.Add(0x01);
 			}
 
-			foreach (var b in Entities())
-				yield return b;
-			
-			yield break;
+			bytes.AddRange(Entities());
+
+			if (!chunked)
+				return bytes;
+
+			// Chunks go after the entities, each one aligned to 4 bytes.  The table has each chunk's offset from the
+			// start of the level, in order of layer, then row, then column
+			int chunk = 0;
+
+			foreach (var layer in visuals) {
+				for (int cy = 0; cy < chunksY; ++cy) {
+					for (int cx = 0; cx < chunksX; ++cx) {
+						while ((bytes.Count & 0x3) != 0)
+							bytes.Add(0xFF);
+
+						int position = bytes.Count;
+						for (int j = 0; j < 4; ++j)
+							bytes[chunkTable + (chunk * 4) + j] = (byte)(position >> (j * 8));
+
+						ushort[] entries = new ushort[ChunkTiles * ChunkTiles];
+
+						// Chunks on the edge of the level are padded with empty tiles
+						for (int y = 0; y < ChunkTiles; ++y) {
+							for (int x = 0; x < ChunkTiles; ++x) {
+								int tx = (cx * ChunkTiles) + x, ty = (cy * ChunkTiles) + y;
+
+								if (tx < mapWidth && ty < mapHeight)
+									entries[x + (y * ChunkTiles)] = layer[tx + (ty * mapWidth)];
+							}
+						}
+
+						bytes.AddRange(LZUtil.Compress(EntryBytes(entries)));
+						++chunk;
+					}
+				}
+			}
+
+			return bytes;
 		}
+		private static byte[] EntryBytes(ushort[] entries) {
+			byte[] retval = new byte[entries.Length * 2];
+
+			for (int i = 0; i < entries.Length; ++i) {
+				retval[i * 2] = (byte)(entries[i] & 0xFF);
+				retval[(i * 2) + 1] = (byte)(entries[i] >> 8);
+			}
 
-		private IEnumerable<byte> Header() {
-			foreach (byte b in BitConverter.GetBytes((short)width))
+			return retval;
+		}
+
+		private IEnumerable<byte> Header(bool chunked) {
+			// The top bit of the width marks a chunked level
+			foreach (byte b in BitConverter.GetBytes((ushort)(width | (chunked ? 0x8000 : 0))))
 				yield return b;
 			foreach (byte b in BitConverter.GetBytes((short)height))
 				yield return b;
@@ -459,7 +582,7 @@ namespace Pixtro.Compiler {
 			
 			yield break;
 		}
-		private byte[] VisualLayer(int layer) {
+		private ushort[] VisualLayer(int layer) {
 			
 			int x, y;
 			
@@ -534,23 +657,20 @@ namespace Pixtro.Compiler {
 				}
 			}
 
-			int count = 0;
+			// Stored as screenblock entries, so the engine can copy tiles straight to the screen
+			int size = Settings.BrickTileSize, mapWidth = width * size;
+			ushort[] entries = new ushort[mapWidth * height * size];
 
-			byte[] retvalArray = new byte[width * height * 2];
+			if (layer == 0)
+				collisionBricks = new Brick[width, height];
 
 			for (y = 0; y < height; ++y)
 			{
 				for (x = 0; x < width; ++x)
 				{
-					ushort retval;
-
 					char currentTile = levelData[layer, x, y];
 
-					if (currentTile == ' ')
-					{
-						retval = 0;
-					}
-					else
+					if (currentTile != ' ')
 					{
 						var wrapping = DataParse.Wrapping[currentTile];
 						Brick mappedTile;
@@ -622,24 +742,49 @@ namespace Pixtro.Compiler {
 							mappedTile = fullTileset.GetBrick(new LargeTile(Settings.BrickTileSize * 8), currentTile);
 						}
 
-						if (mappedTile == null) {
-							retval = 0;
-						}
-						else {
-							retval = (ushort)(fullTileset.GetIndex(mappedTile, currentTile) + 1);
-							retval |= (ushort)(mappedTile.palette << 12);
+						if (mappedTile != null) {
+							ushort[] brickEntries = fullTileset.GetScreenEntries(mappedTile);
+							ushort palette = (ushort)(mappedTile.palette << 12);
+
+							for (int i = 0; i < size * size; ++i)
+								entries[(x * size) + (i % size) + (((y * size) + (i / size)) * mapWidth)] = (ushort)(brickEntries[i] | palette);
 						}
+
+						if (layer == 0)
+							collisionBricks[x, y] = mappedTile;
 					}
+				}
+			}
+
+			return entries;
+		}
+		private Brick[,] collisionBricks;
+
+		// One byte per block, with the collision type in the top 4 bits and the shape in the bottom 4.
+		// Has a one block border copied from the edges, so the engine can read just outside the level without clamping
+		private byte[] CollisionLayer() {
+			int gridWidth = width + 2, gridHeight = height + 2;
 
-					retvalArray[count + 1] = (byte)(retval >> 8);
-					retvalArray[count] = (byte)(retval & 0xFF);
+			byte[] grid = new byte[gridWidth * gridHeight];
+			bool warned = false;
 
-					count += 2;
+			for (int y = 0; y < gridHeight; ++y) {
+				for (int x = 0; x < gridWidth; ++x) {
+					Brick brick = collisionBricks[Math.Clamp(x - 1, 0, width - 1), Math.Clamp(y - 1, 0, height - 1)];
+
+					if (brick == null)
+						continue;
+
+					if (!warned && (brick.collisionType > 0xF || brick.collisionShape > 0xF)) {
+						warned = true;
+						MainProgram.WarningLog($"Collision type {brick.collisionType} and shape {brick.collisionShape} must both be below 16.");
+					}
 
+					grid[x + y * gridWidth] = (byte)((Math.Min(brick.collisionType, 0xF) << 4) | Math.Min(brick.collisionShape, 0xF));
 				}
 			}
 
-			return LZUtil.Compress(retvalArray);
+			return LZUtil.Compress(grid);
 		}
 		private IEnumerable<byte> Entities() {
 			foreach (var ent in entities) {
@@ -499,56 +499,13 @@ namespace Pixtro.Compiler
 				}
 				sourceFile.EndArray();
 
-				// Compile the collision types of each brick
-				sourceFile.BeginArray(SourceFile.ArrayType.UShort, "TILECOLL_" + parse.Name);
-				foreach (var tile in fullTileset)
-				{
-					int index = fullTileset.GetIndex(tile, tile.collisionChar);
-
-					sourceFile.AddValue((tile.collisionType << 8) | tile.collisionShape);
-				}
-				sourceFile.AddValue(0xFFFF);
-				sourceFile.EndArray();
-
-				// Compile each brick's "uv" mapping, aka how each raw tile fits into this tileset
-				sourceFile.BeginArray(SourceFile.ArrayType.UShort, "TILE_MAPPING_" + parse.Name);
-				int size = Settings.BrickTileSize;
-				int count = 0;
-				foreach (var tile in fullTileset)
-				{
-					++count;
-
-					for (int i = 0; i < size * size; ++i)
-					{
-						var brickTile = tile.tiles[i % size, i / size];
-
-						Tile mappedTile = null;
-
-						foreach (var rt in rawTiles)
-						{
-							if (brickTile.EqualTo(rt, FlipStyle.Both))
-							{
-								mappedTile = rt;
-								break;
-							}
-						}
-
-						ushort value = 0;
-						if (mappedTile != null) {
-							value = (ushort)(rawTiles.IndexOf(mappedTile, new CompareFlippable<Tile>()) + 1);
-
-							ushort flip = (ushort)(brickTile.GetFlipOffset(mappedTile) << 10);
-							value |= flip;
-						}
-						
-						sourceFile.AddValue(value);
-					}
-				}
+				// Compile the profiles of the collision shapes bricks can use
+				sourceFile.BeginArray(SourceFile.ArrayType.Char, "TILESHAPES_" + parse.Name);
+				sourceFile.AddRange(CollisionShapes.Compile(parse.Shapes, Settings.BrickTileSize * 8));
 				sourceFile.EndArray();
 
 				// Define how many tiles are in the compiled tileset
 				headerFile.AddValueDefine($"TILESET_{parse.Name}_len", length);
-				headerFile.AddValueDefine($"TILESET_{parse.Name}_uvlen", count);
 
 				parse.fullTileset = fullTileset;
 
@@ -654,9 +611,12 @@ namespace Pixtro.Compiler
 
 			//MainProgram.Log("Compiling Level Packs");
 			// Compile Level Packs
+			int entityBits = 0;
+
 			foreach (var pack in levelPacks)
 			{
 				currentPack = pack.Key;
+				int packEntities = 0;
 
 				sourceFile.BeginArray(SourceFile.ArrayType.UInt, "PACK_" + currentPack);
 
@@ -677,6 +637,13 @@ namespace Pixtro.Compiler
 
 					CompiledLevel level = compiledLevels[levelList[i].Replace('/', '_').Replace('\\', '_')];
 
+					// Each entity gets a bit in the pack, for remembering it's been unloaded
+					sourceFile.AddValue(2 | (level.entities.Count << 4));
+					packEntities += level.entities.Count;
+
+					if (level.entities.Count > 64)
+						MainProgram.WarningLog($"{levelList[i]} has {level.entities.Count} entities, only the first 64 can be kept unloaded.");
+
 					//for (int j = 0; j < level.Layers; ++j)
 					//{
 					//	sourceFile.AddValue((2) | (j << 4));
@@ -687,8 +654,16 @@ namespace Pixtro.Compiler
 				sourceFile.AddValue(0);
 
 				sourceFile.EndArray();
+
+				if (levelList.Count > 64)
+					MainProgram.WarningLog($"Level pack {currentPack} has {levelList.Count} levels, only the first 64 can keep entities unloaded.");
+
+				headerFile.AddValueDefine($"PACK_{currentPack}_entities", packEntities);
+				entityBits = Math.Max(entityBits, packEntities);
 			}
 
+			headerFile.AddValueDefine("LEVEL_ENTITY_BITS", Math.Max(entityBits, 32));
+
 			File.WriteAllText(Path.Combine(Settings.ProjectPath, "build/images.yaml"), MainProgram.SerializeMeta(editTimesNewRoman));
 
 			editTimes.Clear();
@@ -1105,10 +1080,12 @@ namespace Pixtro.Compiler
 					sourceFile.AddRange(img.GetTile().RawData);
 				}
 
-				index += length;
+				index += length + 1;
 			}
 
 			sourceFile.EndArray(true);
+
+			sourceFile.headerFile.AddValueDefine("PARTICLE_FRAMES", Math.Max(index, 1));
 		}
 		private static void CompileBackgrounds()
 		{
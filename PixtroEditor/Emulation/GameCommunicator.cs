@@ -268,6 +268,59 @@ namespace Pixtro.Emulation
 
 			public static implicit operator uint(MemoryMap map) => map.GetUint(0);
 		}
+		// Keep in sync with ProfileFrame in the engine's profiler.h
+		public sealed class ProfileFrame
+		{
+			public static readonly string[] PhaseNames = new string[] {
+				"Inputs",
+				"Entity Update",
+				"Custom Update",
+				"Engine Update",
+				"Idle",
+				"Move Camera",
+				"Begin Drawing",
+				"Particles",
+				"Entity Render",
+				"Custom Render",
+				"End Drawing",
+				"Fade",
+			};
+			public const int IdlePhase = 4;
+			public const int ZoneCount = 8, TypeCount = 32;
+
+			public static int PhaseCount => PhaseNames.Length;
+			public static int Size => (((8 + ((PhaseCount + ZoneCount + TypeCount) * 4) + PhaseCount) + 3) & ~3);
+
+			public uint Frame { get; private set; }
+			public uint Total { get; private set; }
+
+			public uint[] PhaseCycles { get; private set; }
+			public uint[] ZoneCycles { get; private set; }
+			public uint[] TypeCycles { get; private set; }
+			public byte[] PhaseScanline { get; private set; }
+
+			public ProfileFrame(MemoryMap map, int offset)
+			{
+				Frame = map.GetUint(offset);
+				Total = map.GetUint(offset + 4);
+				offset += 8;
+
+				PhaseCycles = new uint[PhaseCount];
+				ZoneCycles = new uint[ZoneCount];
+				TypeCycles = new uint[TypeCount];
+				PhaseScanline = new byte[PhaseCount];
+
+				for (int i = 0; i < PhaseCount; ++i, offset += 4)
+					PhaseCycles[i] = map.GetUint(offset);
+				for (int i = 0; i < ZoneCount; ++i, offset += 4)
+					ZoneCycles[i] = map.GetUint(offset);
+				for (int i = 0; i < TypeCount; ++i, offset += 4)
+					TypeCycles[i] = map.GetUint(offset);
+				for (int i = 0; i < PhaseCount; ++i, offset++)
+					PhaseScanline[i] = map.GetByte(offset);
+			}
+		}
+
 		public static GameCommunicator Instance { get; private set; }
 
 		[RequiredService]
@@ -285,6 +338,8 @@ namespace Pixtro.Emulation
 		public MemoryMap loaded_levels_a { get; private set; }
 		public MemoryMap loaded_levels_b { get; private set; }
 		public MemoryMap current_level_index { get; private set; }
+		public MemoryMap profile_data { get; private set; }
+		public MemoryMap debug_counters { get; private set; }
 
 		[DontHotload]
 		public MemoryMap LevelRegion { get; private set; }
@@ -488,6 +543,58 @@ namespace Pixtro.Emulation
 			return CreateMemoryMap(5, (uint)(palette * 32) + 256, 32);
 		}
 
+		// Keep in sync with DebugCounter in the engine's core.h
+		public enum DebugCounter
+		{
+			DMAQueued,
+			DMACarried,
+			DMAOverflow,
+			DMAPeak,
+
+			SpriteAllocFail,
+			SpriteCacheHit,
+			SpriteCacheMiss,
+			SpriteCacheEvict,
+
+			AffineShared,
+			AffineApprox,
+		}
+
+		// Debug counters are only available in debug builds
+		public uint GetDebugCounter(DebugCounter counter)
+		{
+			if (debug_counters == null)
+				return 0;
+
+			return debug_counters.GetUint((int)counter * 4);
+		}
+
+		// Profiling data is only available in debug builds.  Keep in sync with ProfileData in the engine's profiler.h
+		private const int ProfileHeaderSize = 12;
+
+		// The size of the ring buffer, and the amount of frames in it that have been recorded
+		private int ProfileRingLength => profile_data == null ? 0 : (int)profile_data.GetUint(4);
+		public int ProfileFrameCount => profile_data == null ? 0 : (int)Math.Min(profile_data.GetUint(8), (uint)ProfileRingLength);
+
+		// Get a recorded frame.  Index 0 is the newest frame, and higher indexes go further back
+		public ProfileFrame GetProfileFrame(int framesBack)
+		{
+			int count = ProfileFrameCount, length = ProfileRingLength;
+			if (count == 0 || framesBack >= count)
+				return null;
+
+			int index = ((int)profile_data.GetUint(0) - framesBack + length) % length;
+
+			return new ProfileFrame(profile_data, ProfileHeaderSize + ProfileFrame.Size + (index * ProfileFrame.Size));
+		}
+		public ProfileFrame GetWorstProfileFrame()
+		{
+			if (ProfileFrameCount == 0)
+				return null;
+
+			return new ProfileFrame(profile_data, ProfileHeaderSize);
+		}
+
 		public byte[] GetFromRam(string varName) {
 			if (!iwramMap.ContainsKey(varName))
 				return new byte[0];
@@ -0,0 +1,360 @@
+#include "benchmark.h"
+#include <stdio.h>
+
+#include "entities.h"
+#include "graphics.h"
+#include "level_data.h"
+#include "math.h"
+#include "particles.h"
+#include "physics.h"
+#include "profiler.h"
+
+#ifdef PIXTRO_BENCHMARKS
+
+BenchmarkResult benchmark_results[BENCHMARK_LIMIT];
+int benchmark_count;
+
+// Stops the compiler from throwing away results that are never used
+volatile int benchmark_sink;
+
+static void report(const char* name, unsigned int count, unsigned int cycles) {
+	char line[80];
+
+	cycles /= BENCHMARK_REPEAT;
+
+	if (benchmark_count < BENCHMARK_LIMIT) {
+		benchmark_results[benchmark_count].name	  = name;
+		benchmark_results[benchmark_count].count  = count;
+		benchmark_results[benchmark_count].cycles = cycles;
+		benchmark_count++;
+	}
+
+	siprintf(line, "%-24s %4u: %7u cycles", name, count, cycles);
+	nocash_puts(line);
+}
+
+// ---- Entities ----
+
+// Moves every entity, like the start of a physics step
+HOT_CODE static void entity_move(int count) {
+	int i;
+
+	for (i = 0; i < count; ++i) {
+		ENT_VEL_Y(i) += 0x20;
+		ENT_X(i) += ENT_VEL_X(i);
+		ENT_Y(i) += ENT_VEL_Y(i);
+	}
+}
+// Checks every detectable entity's hitbox against a rectangle, like collide_entity does
+HOT_CODE static int entity_overlap(int count, int left, int top, int right, int bottom) {
+	int i, hits = 0;
+
+	for (i = 0; i < count; ++i) {
+		if (!ENT_FLAG(DETECT, i))
+			continue;
+
+		int x = FIXED2INT(ENT_X(i)), y = FIXED2INT(ENT_Y(i));
+
+		hits += !(right < x || x + ENT_WIDTH(i) <= left || bottom < y || y + ENT_HEIGHT(i) <= top);
+	}
+
+	return hits;
+}
+
+static void benchmark_entities() {
+	static const int counts[] = {16, 64, 128};
+
+	int c, i, r;
+
+	for (c = 0; c < 3; ++c) {
+		int count = counts[c];
+
+		if (count > ENTITY_LIMIT) {
+			nocash_puts("Entity benchmarks past ENTITY_LIMIT skipped");
+			break;
+		}
+
+		for (i = 0; i < count; ++i) {
+			ENT_X(i)	  = INT2FIXED((i * 37) & 0xFF);
+			ENT_Y(i)	  = INT2FIXED((i * 91) & 0xFF);
+			ENT_VEL_X(i)  = 0x80;
+			ENT_VEL_Y(i)  = 0;
+			ENT_WIDTH(i)  = 16;
+			ENT_HEIGHT(i) = 16;
+			ENT_ID(i)	  = ENT_LOADED_FLAG | ENT_ACTIVE_FLAG | ENT_DETECT_FLAG;
+		}
+
+		unsigned int start = cycle_count();
+		for (r = 0; r < BENCHMARK_REPEAT; ++r)
+			entity_move(count);
+		report("Entity move", count, cycle_count() - start);
+
+		start = cycle_count();
+		for (r = 0; r < BENCHMARK_REPEAT; ++r)
+			benchmark_sink += entity_overlap(count, 64, 64, 128, 128);
+		report("Entity overlap", count, cycle_count() - start);
+	}
+
+	// Leave every slot empty for the game
+	for (i = 0; i < ENTITY_LIMIT; ++i)
+		ENT_ID(i) = 0;
+
+	reset_entity_lists();
+}
+
+// ---- Math ----
+
+// The engine's original versions, to compare the current ones against
+extern const int sine_table[91];
+
+static int old_deg_sin(int angle) {
+	while (angle < 0)
+		angle += 360;
+	while (angle >= 360)
+		angle -= 360;
+
+	if (angle < 90)
+		return sine_table[angle];
+	else if (angle < 180)
+		return sine_table[180 - angle];
+	else if (angle < 270)
+		return -sine_table[angle - 180];
+	else
+		return -sine_table[360 - angle];
+}
+static int old_fixed_div(int a, int b) {
+	return INT2FIXED(a) / b;
+}
+static AffineMatrix old_matrix_multiply(AffineMatrix b, AffineMatrix a) {
+	int x, y, i;
+
+	AffineMatrix ret;
+
+	int b_values[9];
+
+	for (x = 0; x < 6; ++x)
+		b_values[x] = b.values[x];
+
+	b_values[6] = 0;
+	b_values[7] = 0;
+	b_values[8] = 0x100;
+
+	for (x = 0; x < 3; ++x)
+		for (y = 0; y < 6; y += 3) {
+			ret.values[x + y] = 0;
+			for (i = 0; i < 3; ++i)
+				ret.values[x + y] += FIXED_MULT(a.values[i + y], b_values[x + (i * 3)]);
+		}
+
+	return ret;
+}
+
+#define MATH_COUNT 64
+
+static void benchmark_math() {
+	int i, r, sum;
+	unsigned int start;
+
+	// Angles a few turns either side of 0, like an object spinning for a while
+	start = cycle_count();
+	for (r = 0, sum = 0; r < BENCHMARK_REPEAT; ++r)
+		for (i = 0; i < MATH_COUNT; ++i)
+			sum += old_deg_sin(i * 47 - 1500);
+	benchmark_sink += sum;
+	report("Sin (old loops)", MATH_COUNT, cycle_count() - start);
+
+	start = cycle_count();
+	for (r = 0, sum = 0; r < BENCHMARK_REPEAT; ++r)
+		for (i = 0; i < MATH_COUNT; ++i)
+			sum += int_deg_sin(i * 47 - 1500);
+	benchmark_sink += sum;
+	report("Sin (int_deg_sin)", MATH_COUNT, cycle_count() - start);
+
+	start = cycle_count();
+	for (r = 0, sum = 0; r < BENCHMARK_REPEAT; ++r)
+		for (i = 0; i < MATH_COUNT; ++i)
+			sum += ANGLE_SIN(i * 11);
+	benchmark_sink += sum;
+	report("Sin (ANGLE_SIN)", MATH_COUNT, cycle_count() - start);
+
+	start = cycle_count();
+	for (r = 0, sum = 0; r < BENCHMARK_REPEAT; ++r)
+		for (i = 0; i < MATH_COUNT; ++i)
+			sum += old_fixed_div(i * 0x135 - 0x2000, i * 0x29 + 0x40);
+	benchmark_sink += sum;
+	report("Divide (old /)", MATH_COUNT, cycle_count() - start);
+
+	start = cycle_count();
+	for (r = 0, sum = 0; r < BENCHMARK_REPEAT; ++r)
+		for (i = 0; i < MATH_COUNT; ++i)
+			sum += fixed_div(i * 0x135 - 0x2000, i * 0x29 + 0x40);
+	benchmark_sink += sum;
+	report("Divide (fixed_div)", MATH_COUNT, cycle_count() - start);
+
+	AffineMatrix m = matrix_rot(30), step = matrix_trans(0x180, -0x40);
+
+	start = cycle_count();
+	for (r = 0; r < BENCHMARK_REPEAT; ++r)
+		for (i = 0; i < MATH_COUNT; ++i)
+			m = old_matrix_multiply(m, step);
+	benchmark_sink += m.values[2];
+	report("Matrix (old multiply)", MATH_COUNT, cycle_count() - start);
+
+	start = cycle_count();
+	for (r = 0; r < BENCHMARK_REPEAT; ++r)
+		for (i = 0; i < MATH_COUNT; ++i)
+			m = matrix_multiply(m, step);
+	benchmark_sink += m.values[2];
+	report("Matrix (multiply)", MATH_COUNT, cycle_count() - start);
+
+	start = cycle_count();
+	for (r = 0; r < BENCHMARK_REPEAT; ++r)
+		for (i = 0; i < MATH_COUNT; ++i)
+			m = old_matrix_multiply(m, matrix_rot(i));
+	benchmark_sink += m.values[0];
+	report("Rotate (old multiply)", MATH_COUNT, cycle_count() - start);
+
+	start = cycle_count();
+	for (r = 0; r < BENCHMARK_REPEAT; ++r)
+		for (i = 0; i < MATH_COUNT; ++i)
+			ROTATE_MATRIX(m, i);
+	benchmark_sink += m.values[0];
+	report("Rotate (in place)", MATH_COUNT, cycle_count() - start);
+}
+
+// ---- Hot paths ----
+
+// The per frame functions that IWRAM_HOT_PATHS moves, run on a made up level
+
+extern HOT_CODE void begin_drawing();
+extern HOT_CODE void update_particles();
+
+#define HOT_ENTITIES 64
+#define HOT_RECTS	 64
+#define HOT_BANKS	 32
+
+static void place_hot_entities(int count) {
+	int i;
+
+	for (i = 0; i < count; ++i) {
+		ENT_X(i)	  = INT2FIXED(32 + ((i * 37) & 0x1FF));
+		ENT_Y(i)	  = INT2FIXED(32 + ((i * 91) & 0x15F));
+		ENT_VEL_X(i)  = (i & 1) ? 0x180 : -0x180;
+		ENT_VEL_Y(i)  = 0x200;
+		ENT_WIDTH(i)  = 12;
+		ENT_HEIGHT(i) = 14;
+		ENT_ID(i)	  = ENT_LOADED_FLAG | ENT_ACTIVE_FLAG;
+	}
+}
+
+static void benchmark_hot_paths() {
+	int i, r;
+	unsigned int start, cycles;
+
+	init_drawing();
+	load_benchmark_level(64, 48);
+	change_layer_type(0, LStyle_FG);
+
+	// The first call sets up the layer's screen block
+	begin_drawing();
+
+	cam_x = 200;
+	cam_y = 150;
+	reset_cam();
+
+	// A diagonal scroll, so each call streams in a row and a column
+	start = cycle_count();
+	for (r = 0; r < BENCHMARK_REPEAT; ++r) {
+		cam_x += 8;
+		cam_y += 4;
+		move_cam();
+	}
+	report("move_cam", 1, cycle_count() - start);
+
+	int count = HOT_ENTITIES > ENTITY_LIMIT ? ENTITY_LIMIT : HOT_ENTITIES;
+
+	// The entities are put back before each run, so every run falls into the same blocks
+	for (r = 0, cycles = 0; r < BENCHMARK_REPEAT; ++r) {
+		place_hot_entities(count);
+
+		start = cycle_count();
+		for (i = 0; i < count; ++i)
+			benchmark_sink += entity_physics_at(i, 1);
+		cycles += cycle_count() - start;
+	}
+	report("entity_physics_at", count, cycles);
+
+	start = cycle_count();
+	for (r = 0; r < BENCHMARK_REPEAT; ++r)
+		for (i = 0; i < HOT_RECTS; ++i)
+			benchmark_sink += collide_rect(16 + ((i * 53) & 0x1FF), 16 + ((i * 29) & 0x15F), 16, 16, 1);
+	report("collide_rect", HOT_RECTS, cycle_count() - start);
+
+	// Particles that stay still in the middle of the screen for the whole test
+	int emitter = add_emitter(INT2FIXED(cam_x), INT2FIXED(cam_y), 0, 0, 0xFF);
+
+	if (emitter >= 0) {
+		particle_emitters[emitter].vel_x	= 0;
+		particle_emitters[emitter].vel_y	= 0;
+		particle_emitters[emitter].spread_x = 0;
+		particle_emitters[emitter].spread_y = 0;
+		particle_emitters[emitter].gravity	= 0;
+		emit_particles(emitter, 64);
+	}
+
+	if (particle_count) {
+		count = particle_count;
+
+		start = cycle_count();
+		for (r = 0; r < BENCHMARK_REPEAT; ++r)
+			update_particles();
+		report("update_particles", count, cycle_count() - start);
+	} else {
+		nocash_puts("update_particles skipped, no particles");
+	}
+
+	if (emitter >= 0)
+		remove_emitter(emitter);
+	clear_particles();
+
+	// Banks animating every frame, the work begin_drawing does for animated sprites
+	animate_benchmark_banks(HOT_BANKS);
+
+	start = cycle_count();
+	for (r = 0; r < BENCHMARK_REPEAT; ++r)
+		begin_drawing();
+	report("begin_drawing", HOT_BANKS, cycle_count() - start);
+
+	animate_benchmark_banks(0);
+
+	for (i = 0; i < ENTITY_LIMIT; ++i)
+		ENT_ID(i) = 0;
+	reset_entity_lists();
+
+	change_layer_type(0, LStyle_Free);
+	unload_benchmark_level();
+	cam_x = 0;
+	cam_y = 0;
+}
+
+void run_benchmarks() {
+	benchmark_count = 0;
+
+#ifdef ENTITY_SOA
+	nocash_puts("Benchmarks (ENTITY_SOA)");
+#else
+	nocash_puts("Benchmarks");
+#endif
+
+#ifdef IWRAM_HOT_PATHS
+	nocash_puts("Hot paths in IWRAM");
+#else
+	nocash_puts("Hot paths in ROM");
+#endif
+
+	benchmark_entities();
+	benchmark_math();
+	benchmark_hot_paths();
+}
+
+#endif
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "core.h"
+
+// ---- Benchmarks ----
+//
+// Only used when PIXTRO_BENCHMARKS is defined in engine.h.
+// Times engine code with the cycle counter when the game starts, before init() runs, and prints the results to the
+// emulator's debug log (mGBA and no$gba).  Results are also kept in `benchmark_results` to read from a debugger.
+// Compare builds with and without an option (ENTITY_SOA, IWRAM_HOT_PATHS) to see what it changes
+
+// Times each test is run, with the average being reported
+#ifndef BENCHMARK_REPEAT
+#define BENCHMARK_REPEAT 16
+#endif
+
+#define BENCHMARK_LIMIT 32
+
+typedef struct {
+	const char* name;
+	// The amount of items the test went through
+	unsigned int count;
+	// Average cycles per run
+	unsigned int cycles;
+} BenchmarkResult;
+
+extern BenchmarkResult benchmark_results[BENCHMARK_LIMIT];
+extern int benchmark_count;
+
+void run_benchmarks();
+
+// Set up and clear the state the hot path benchmarks run in
+void load_benchmark_level(int width, int height);
+void unload_benchmark_level();
+void animate_benchmark_banks(int count);
@@ -0,0 +1,225 @@
+#include "broadphase.h"
+#include <string.h>
+
+#include "math.h"
+
+// Cells are hashed into buckets, so the grid doesn't need to cover the whole level
+#define BUCKET_BITS 6
+#define BUCKETS		(1 << BUCKET_BITS)
+
+// Entities covering more cells than this go into a list that's checked by everything instead
+#define MAX_CELLS	4
+#define ENTRY_LIMIT (ENTITY_LIMIT * MAX_CELLS)
+#define NO_ENTRY	0xFFFF
+
+#define CELL_KEY(x, y) (((unsigned int)(x)&0xFFFF) | ((unsigned int)(y) << 16))
+#define CELL_BUCKET(k) (((k)*0x9E3779B1) >> (32 - BUCKET_BITS))
+
+unsigned short bucket_head[BUCKETS];
+
+// Each entry is one entity in one cell
+unsigned short entry_next[ENTRY_LIMIT], entry_entity[ENTRY_LIMIT];
+unsigned int entry_cell[ENTRY_LIMIT];
+int entry_count;
+
+unsigned short large_entities[ENTITY_LIMIT];
+int large_count;
+
+// Detectable entities when the grid was built, and the first cell each one covers
+unsigned short broad_items[ENTITY_LIMIT];
+int broad_count;
+short broad_cell_x[ENTITY_LIMIT], broad_cell_y[ENTITY_LIMIT];
+unsigned char broad_large[ENTITY_LIMIT];
+
+// Stamped with the current query, so entities covering multiple cells are only counted once
+unsigned short query_stamp[ENTITY_LIMIT];
+unsigned short query_id;
+
+void broadphase_build() {
+	int i, x, y;
+
+	memset(bucket_head, 0xFF, sizeof(bucket_head));
+	entry_count = 0;
+	large_count = 0;
+	broad_count = 0;
+
+	for (i = 0; i < detect_entities.count; ++i) {
+		int index = detect_entities.items[i];
+
+		if (ENT_WIDTH(index) <= 0 || ENT_HEIGHT(index) <= 0)
+			continue;
+
+		int left = FIXED2INT(ENT_X(index)) >> BROADPHASE_CELL_SHIFT,
+			top	 = FIXED2INT(ENT_Y(index)) >> BROADPHASE_CELL_SHIFT,
+			rgt	 = (FIXED2INT(ENT_X(index)) + ENT_WIDTH(index) - 1) >> BROADPHASE_CELL_SHIFT,
+			bot	 = (FIXED2INT(ENT_Y(index)) + ENT_HEIGHT(index) - 1) >> BROADPHASE_CELL_SHIFT;
+
+		broad_items[broad_count++] = index;
+		broad_cell_x[index]		   = left;
+		broad_cell_y[index]		   = top;
+
+		if ((rgt - left + 1) * (bot - top + 1) > MAX_CELLS) {
+			broad_large[index]			   = 1;
+			large_entities[large_count++] = index;
+			continue;
+		}
+
+		broad_large[index] = 0;
+
+		for (y = top; y <= bot; ++y) {
+			for (x = left; x <= rgt; ++x) {
+				unsigned int key	= CELL_KEY(x, y);
+				unsigned int bucket = CELL_BUCKET(key);
+
+				entry_entity[entry_count] = index;
+				entry_cell[entry_count]	  = key;
+				entry_next[entry_count]	  = bucket_head[bucket];
+				bucket_head[bucket]		  = entry_count++;
+			}
+		}
+	}
+}
+
+// Start a new query, so every entity can be counted again
+static void next_query() {
+	if (!++query_id) {
+		memset(query_stamp, 0, sizeof(query_stamp));
+		query_id = 1;
+	}
+}
+
+// Check an entity against a rectangle, using where the entity is now
+static inline int overlaps(unsigned int index, int left, int top, int right, int bottom) {
+	int ent_left = FIXED2INT(ENT_X(index)),
+		ent_top	 = FIXED2INT(ENT_Y(index));
+
+	return !(right < ent_left || ent_left + ENT_WIDTH(index) - 1 < left ||
+			 bottom < ent_top || ent_top + ENT_HEIGHT(index) - 1 < top);
+}
+
+int broadphase_query(int x, int y, int width, int height, unsigned int layer_mask, int ignore, unsigned short* hits, int max_hits) {
+	if (width <= 0 || height <= 0 || max_hits <= 0)
+		return 0;
+
+	int right = x + width - 1, bottom = y + height - 1;
+	int cell_x, cell_y, i, count = 0;
+
+	next_query();
+
+	// Entities that were too big for the grid
+	for (i = 0; i < large_count; ++i) {
+		int index = large_entities[i];
+
+		if (index == ignore || !(ENT_LAYERS(index) & layer_mask) || !ENT_IN_LIST(detect_entities, index))
+			continue;
+
+		if (overlaps(index, x, y, right, bottom)) {
+			hits[count++] = index;
+
+			if (count == max_hits)
+				return count;
+		}
+	}
+
+	for (cell_y = y >> BROADPHASE_CELL_SHIFT; cell_y <= bottom >> BROADPHASE_CELL_SHIFT; ++cell_y) {
+		for (cell_x = x >> BROADPHASE_CELL_SHIFT; cell_x <= right >> BROADPHASE_CELL_SHIFT; ++cell_x) {
+			unsigned int key = CELL_KEY(cell_x, cell_y);
+			int entry;
+
+			for (entry = bucket_head[CELL_BUCKET(key)]; entry != NO_ENTRY; entry = entry_next[entry]) {
+				int index = entry_entity[entry];
+
+				if (entry_cell[entry] != key || query_stamp[index] == query_id)
+					continue;
+
+				query_stamp[index] = query_id;
+
+				if (index == ignore || !(ENT_LAYERS(index) & layer_mask) || !ENT_IN_LIST(detect_entities, index))
+					continue;
+
+				if (overlaps(index, x, y, right, bottom)) {
+					hits[count++] = index;
+
+					if (count == max_hits)
+						return count;
+				}
+			}
+		}
+	}
+
+	return count;
+}
+int broadphase_query_entity(unsigned int index, unsigned int layer_mask, unsigned short* hits, int max_hits) {
+	return broadphase_query(FIXED2INT(ENT_X(index)), FIXED2INT(ENT_Y(index)), ENT_WIDTH(index), ENT_HEIGHT(index),
+							layer_mask, index, hits, max_hits);
+}
+
+// Report a pair if they're on the right layers and still overlapping
+static void check_pair(unsigned int a, unsigned int b, unsigned int layers_a, unsigned int layers_b, BroadphasePairFunc callback) {
+	int swap;
+
+	if ((ENT_LAYERS(a) & layers_a) && (ENT_LAYERS(b) & layers_b))
+		swap = 0;
+	else if ((ENT_LAYERS(b) & layers_a) && (ENT_LAYERS(a) & layers_b))
+		swap = 1;
+	else
+		return;
+
+	// The callback may have unloaded either of them
+	if (!ENT_IN_LIST(detect_entities, a) || !ENT_IN_LIST(detect_entities, b))
+		return;
+
+	int left = FIXED2INT(ENT_X(a)), top = FIXED2INT(ENT_Y(a));
+
+	if (!overlaps(b, left, top, left + ENT_WIDTH(a) - 1, top + ENT_HEIGHT(a) - 1))
+		return;
+
+	if (swap)
+		callback(b, a);
+	else
+		callback(a, b);
+}
+
+void broadphase_pairs(unsigned int layers_a, unsigned int layers_b, BroadphasePairFunc callback) {
+	int i, j, bucket;
+
+	// Entities too big for the grid get checked against everything
+	for (i = 0; i < large_count; ++i) {
+		int large = large_entities[i];
+
+		for (j = 0; j < broad_count; ++j) {
+			int other = broad_items[j];
+
+			// Only check two large entities against each other once
+			if (other == large || (broad_large[other] && other < large))
+				continue;
+
+			check_pair(large, other, layers_a, layers_b, callback);
+		}
+	}
+
+	for (bucket = 0; bucket < BUCKETS; ++bucket) {
+		int first, second;
+
+		for (first = bucket_head[bucket]; first != NO_ENTRY; first = entry_next[first]) {
+			unsigned int key = entry_cell[first];
+
+			int a	   = entry_entity[first];
+			int cell_x = (short)(key & 0xFFFF), cell_y = (int)key >> 16;
+
+			for (second = entry_next[first]; second != NO_ENTRY; second = entry_next[second]) {
+				if (entry_cell[second] != key)
+					continue;
+
+				int b = entry_entity[second];
+
+				// Pairs sharing more than one cell are only checked in the top left cell they share
+				if (cell_x != (broad_cell_x[a] > broad_cell_x[b] ? broad_cell_x[a] : broad_cell_x[b]) ||
+					cell_y != (broad_cell_y[a] > broad_cell_y[b] ? broad_cell_y[a] : broad_cell_y[b]))
+					continue;
+
+				check_pair(a, b, layers_a, layers_b, callback);
+			}
+		}
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "core.h"
+#include "entities.h"
+
+// ---- Broadphase ----
+//
+// Detectable entities (ENT_DETECT_FLAG) are sorted into a grid of cells once a frame, right before entities update.
+// Queries only check the entities in the cells they touch instead of every entity.
+// Entities are sorted by where they were when the grid was built, so one that moves more than a cell during the frame
+// can be missed until next frame.  Call broadphase_build() again after teleporting entities if that matters
+
+// The size of each cell as a shift, 5 being 32 pixels.  Should be around the size of most entities
+#ifndef BROADPHASE_CELL_SHIFT
+#define BROADPHASE_CELL_SHIFT 5
+#endif
+
+// Called with each overlapping pair.  `a` is always the entity on the first set of layers
+typedef void (*BroadphasePairFunc)(unsigned int a, unsigned int b);
+
+// Sort every detectable entity into the grid
+void broadphase_build();
+
+// Find every detectable entity on one of `layer_mask`'s layers overlapping the rectangle, not counting `ignore`.
+// Writes up to `max_hits` entity indexes into `hits`, and returns the amount found
+int broadphase_query(int x, int y, int width, int height, unsigned int layer_mask, int ignore, unsigned short* hits, int max_hits);
+// Same as broadphase_query, using an entity's hitbox
+int broadphase_query_entity(unsigned int index, unsigned int layer_mask, unsigned short* hits, int max_hits);
+
+// Run `callback` on every pair of overlapping entities where one is on `layers_a` and the other is on `layers_b`.
+// Each pair is only reported once
+void broadphase_pairs(unsigned int layers_a, unsigned int layers_b, BroadphasePairFunc callback);
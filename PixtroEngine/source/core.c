@@ -1,12 +1,18 @@
 #include <string.h>
 
 #include "core.h"
+#include "benchmark.h"
+#include "broadphase.h"
 #include "coroutine.h"
+#include "dma_queue.h"
 #include "graphics.h"
 #include "load_data.h"
 #include "loading.h"
 #include "math.h"
+#include "palette.h"
 #include "physics.h"
+#include "profiler.h"
+#include "scanline.h"
 
 int layer_count, layer_line[7], layer_index;
 int bg_tile_allowance;
@@ -17,7 +23,14 @@ Layer layers[4];
 unsigned int max_entities;
 
 int (*entity_inits[32])(unsigned int actor_index, unsigned char* data, unsigned char* is_loading);
+#ifdef ENTITY_SOA
+int entity_x[ENTITY_LIMIT], entity_y[ENTITY_LIMIT], entity_vel_x[ENTITY_LIMIT], entity_vel_y[ENTITY_LIMIT];
+unsigned short entity_width[ENTITY_LIMIT], entity_height[ENTITY_LIMIT];
+unsigned int entity_id[ENTITY_LIMIT];
+unsigned int entity_data[ENTITY_LIMIT][6];
+#else
 Entity entities[ENTITY_LIMIT];
+#endif
 void (*entity_update[32])(unsigned int index);
 void (*entity_render[32])(unsigned int index);
 
@@ -33,6 +46,10 @@ unsigned int engine_flags;
 
 unsigned int debug_flags;
 
+#ifdef __DEBUG__
+unsigned int debug_counters[DEBUG_COUNTER_COUNT];
+#endif
+
 #ifdef __DEBUG__
 
 unsigned int debug_engine_flags, debug_game_flags;
@@ -48,10 +65,10 @@ unsigned int debug_engine_flags, debug_game_flags;
 #endif
 
 int fade_timer;
+// Palette fade amount for each step of the fade
+const unsigned char fade_amounts[6] = {0, 6, 13, 19, 26, PAL_BLEND_MAX};
 
 // Saveram
-#define SAVE_INDEX (save_file_number * SAVEFILE_LEN) + SETTING_LEN
-
 char save_data[SAVEFILE_LEN], settings_file[SETTING_LEN];
 int save_file_number;
 
@@ -60,25 +77,36 @@ void (*custom_update)(void);
 void (*custom_render)(void);
 
 void load_settings();
-void interrupt();
 void load_background_tiles(int index, unsigned int* tiles, unsigned int tile_len, int size);
 
 extern void init();
 extern void init_settings();
 
-extern void rng_seed(unsigned int seed1, unsigned int seed2, unsigned int seed3);
 
 extern void init_inputs();
-extern void begin_drawing();
-extern void update_particles();
+extern HOT_CODE void begin_drawing();
+extern HOT_CODE void update_particles();
+extern HOT_CODE void draw_particles();
+extern HOT_CODE void move_cam();
 extern void update_inputs();
 extern void load_entities();
+extern void async_loading();
 
 // Initialize the game
 void pixtro_init() {
 
 	loading_routine.at = -1;
 
+	reset_entity_lists();
+
+	// Start the cycle counter used for profiling and timing engine work
+	cycle_counter_start();
+	profile_init();
+
+#ifdef PIXTRO_BENCHMARKS
+	run_benchmarks();
+#endif
+
 	init_inputs();
 
 	// Set the RNG seeds.  Values can be any positive integer
@@ -97,9 +125,25 @@ void pixtro_init() {
 	init();
 }
 
+// The low priority entity that was first to be put off to the next frame, or -1
+int deferred_entity = -1;
+
+static void update_entity(int index, int type) {
+	entity_frames_elapsed	  = (unsigned short)(game_life - entity_last_update[index]);
+	entity_last_update[index] = game_life;
+
+	PROFILE_TYPE_BEGIN();
+
+	entity_update[type](index);
+
+	PROFILE_TYPE_END(type);
+}
+
 // The game's update loop
 void pixtro_update() {
 
+	profile_start_frame();
+
 	// Skip running update if editor wants game paused
 #ifdef __DEBUG__
 	if (ENGINE_DEBUGFLAG(PAUSE_UPDATES))
@@ -114,10 +158,15 @@ void pixtro_update() {
 	// Update inputs
 	update_inputs();
 
+	PROFILE_PHASE(INPUTS);
+
 	if (fade_timer == 10)
 		fade_timer = 0;
 
 	if (fade_timer == 5) {
+		if (drawing_flags & DFLAG_COMPACT_SPRITES)
+			compact_sprites();
+
 		if (onfade_function) {
 			onfade_function(&onfade_routine);
 
@@ -131,30 +180,96 @@ void pixtro_update() {
 	} else {
 		// Update engine when not fading
 		if (!fade_timer) {
-			if (game_freeze <= 0) {
+			// Entities wait while a level loads in, since the level's collision grid is only partly decoded until it's done
+			if (game_freeze <= 0 && !ENGINE_HAS_FLAG(LOADING_ASYNC)) {
+				broadphase_build();
+
+				// Copy the active list, since entities can be added or removed while updating
+				int count = active_entities.count;
+				unsigned short update_list[ENTITY_LIMIT];
+
+				memcpy(update_list, active_entities.items, count * sizeof(unsigned short));
+
+				unsigned int budget_start = cycle_count();
+
+				// Low priority entities that are due to update this frame
+				unsigned short due_list[ENTITY_LIMIT];
+				int due_count = 0;
+
 				// Run over every active entity and run it's custom update
-				for (i = 0; i < max_entities; ++i) {
-					if (!ENT_FLAG(ACTIVE, i) || !ENT_FLAG(LOADED, i) || !entity_update[ENT_TYPE(i)])
+				for (i = 0; i < count; ++i) {
+					int index = update_list[i];
+					int type  = ENT_TYPE(index);
+
+					if (!ENT_IN_LIST(active_entities, index) || !entity_update[type])
 						continue;
 
-					entity_update[ENT_TYPE(i)](i);
+					// Low priority entities count down to their next update, and update after everything else
+					if (entity_update_period[type] > 1) {
+						if (!entity_update_timer[index] || !--entity_update_timer[index])
+							due_list[due_count++] = index;
+						continue;
+					}
+
+					update_entity(index, type);
 				}
-			} else {
+
+				// Start from the entity that ran out of time last frame, so the same ones aren't always left waiting
+				int first = 0;
+
+				for (i = 0; i < due_count; ++i) {
+					if (due_list[i] == deferred_entity) {
+						first = i;
+						break;
+					}
+				}
+
+				deferred_entity = -1;
+
+				for (i = 0; i < due_count; ++i) {
+					int at = first + i;
+
+					if (at >= due_count)
+						at -= due_count;
+
+					int index = due_list[at];
+					int type  = ENT_TYPE(index);
+
+					if (!ENT_IN_LIST(active_entities, index) || !entity_update[type] || entity_update_period[type] <= 1)
+						continue;
+
+					// Out of time this frame.  The timers of the rest stay at 0, so they update next frame instead
+					if (cycle_count() - budget_start > ENTITY_UPDATE_BUDGET) {
+						deferred_entity = index;
+						break;
+					}
+
+					entity_update_timer[index] = entity_update_period[type];
+
+					update_entity(index, type);
+				}
+			} else if (game_freeze > 0) {
 				game_freeze--;
 			}
 
+			PROFILE_PHASE(ENTITY_UPDATE);
+
 			// Custom update if desired
 			if (custom_update)
 				custom_update();
+
+			PROFILE_PHASE(CUSTOM_UPDATE);
 		} else
 			fade_timer++;
 	}
 
 	// pal_bg_mem[0] = 0xFFFF;
 
-	// if (ENGINE_HAS_FLAG(LOADING_ASYNC)) {
-	// 	async_loading();
-	// }
+	if (ENGINE_HAS_FLAG(LOADING_ASYNC)) {
+		async_loading();
+	}
+
+	PROFILE_PHASE(ENGINE_UPDATE);
 }
 
 // Rendering the game
@@ -164,36 +279,78 @@ void pixtro_render() {
 
 	int i;
 
+	PROFILE_PHASE(IDLE);
+
 	// Set the camera position and load in level if the camera has moved (and if there is any level)
 	move_cam();
+
+#ifdef SCANLINE_EFFECTS
+	update_scanlines();
+#endif
+
+	PROFILE_PHASE(MOVE_CAM);
+
 	begin_drawing();
 
+	PROFILE_PHASE(BEGIN_DRAWING);
+
 	// Update and render particles
 	update_particles();
 
+	PROFILE_PHASE(PARTICLES);
+
 	if (fade_timer != 5) {
 
 		// Render each visible entity
-		for (i = 0; i < max_entities; ++i) {
-			if (!ENT_FLAG(VISIBLE, i) || !ENT_FLAG(LOADED, i) || !entity_render[ENT_TYPE(i)])
+		for (i = 0; i < visible_entities.count; ++i) {
+			int index = visible_entities.items[i];
+
+			if (!entity_render[ENT_TYPE(index)])
 				continue;
 
 			SET_DRAWING_FLAG(CAM_FOLLOW);
 
-			entity_render[ENT_TYPE(i)](i);
+			entity_render[ENT_TYPE(index)](index);
 		}
 	}
 
+	PROFILE_PHASE(ENTITY_RENDER);
+
 	// Custom render if desired
 	if (custom_render)
 		custom_render();
 
+	PROFILE_PHASE(CUSTOM_RENDER);
+
+	// Particles get whatever sprites are left
+	draw_particles();
+
+	PROFILE_PHASE(PARTICLES);
+
 	// Finalize the graphics and prepare for the next cycle
 	end_drawing();
 
+	PROFILE_PHASE(END_DRAWING);
+
 	if (fade_timer) {
-		fade_black(fade_timer <= 5 ? fade_timer : (10 - fade_timer));
+		palette_fade(fade_color, fade_amounts[fade_timer <= 5 ? fade_timer : (10 - fade_timer)]);
 	}
+
+	update_palettes();
+
+	PROFILE_PHASE(FADE);
+
+	profile_end_frame();
+}
+
+// Runs at the start of VBlank
+void pixtro_vblank() {
+	palette_vblank();
+	commit_oam();
+#ifdef SCANLINE_EFFECTS
+	scanline_vblank();
+#endif
+	dma_queue_vblank();
 }
 
 // Basic engine functions
@@ -243,62 +400,173 @@ void reset_settings() {
 }
 
 // Save Files
+// Every save slot has two banks that are written to in turns.  Each bank starts with a header holding a
+// sequence number and a CRC of the data, which is written after the data.  If a save gets cut off, the
+// bank's CRC won't match, and the other bank is loaded instead.
+// Only the 16 byte ranges of save_data that changed since a bank was last written get written to it.
+
+#define SAVE_MAGIC		 0x5850
+#define SAVE_HEADER_LEN	 8
+#define SAVE_BANK_LEN	 (SAVE_HEADER_LEN + SAVEFILE_LEN)
+#define SAVE_BANK_INDEX(bank) (SETTING_LEN + (save_file_number * SAVE_BANK_LEN * 2) + ((bank) * SAVE_BANK_LEN))
+
+#define SAVE_RANGE_SHIFT 4
+#define SAVE_RANGES		 ((SAVEFILE_LEN + (1 << SAVE_RANGE_SHIFT) - 1) >> SAVE_RANGE_SHIFT)
+#define SAVE_DIRTY_WORDS ((SAVE_RANGES + 31) >> 5)
+
+// Bank last written to, and it's sequence number
+int save_bank;
+unsigned int save_sequence;
+// Ranges of save_data that still need to be written to each bank
+unsigned int save_dirty[2][SAVE_DIRTY_WORDS];
+
+const unsigned short crc_nibble_table[16] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+// CRC-16-CCITT, one nibble at a time
+unsigned int crc16(unsigned int crc, const unsigned char* data, int len) {
+	while (len--) {
+		crc = (crc << 4) ^ crc_nibble_table[((crc >> 12) ^ (*data >> 4)) & 0xF];
+		crc = (crc << 4) ^ crc_nibble_table[((crc >> 12) ^ *data) & 0xF];
+		data++;
+	}
+
+	return crc & 0xFFFF;
+}
+unsigned int save_crc(const unsigned char* data, unsigned int sequence) {
+	unsigned char seq[4] = {sequence, sequence >> 8, sequence >> 16, sequence >> 24};
+
+	return crc16(crc16(0xFFFF, data, SAVEFILE_LEN), seq, 4);
+}
+
+unsigned int sram_read(int index, int len) {
+	unsigned int val = 0;
+
+	while (len--)
+		val = (val << 8) | sram_mem[index + len];
+
+	return val;
+}
+void sram_write(int index, unsigned int value, int len) {
+	while (len--) {
+		sram_mem[index++] = value;
+		value >>= 8;
+	}
+}
+
+// Mark a range of save_data as changed, so the next save writes it
+void mark_file_dirty(int index, int len) {
+	int range = index >> SAVE_RANGE_SHIFT;
+	int last  = (index + len - 1) >> SAVE_RANGE_SHIFT;
+
+	for (; range <= last; ++range) {
+		save_dirty[0][range >> 5] |= 1 << (range & 0x1F);
+		save_dirty[1][range >> 5] |= 1 << (range & 0x1F);
+	}
+}
+void mark_bank_dirty(int bank) {
+	int i;
+
+	for (i = 0; i < SAVE_DIRTY_WORDS; ++i)
+		save_dirty[bank][i] = 0xFFFFFFFF;
+}
+
+// Read a bank into save_data, returns 0 if the bank isn't valid
+int load_bank(int bank) {
+	int index = SAVE_BANK_INDEX(bank);
+
+	if (sram_read(index, 2) != SAVE_MAGIC)
+		return 0;
+
+	unsigned int crc	  = sram_read(index + 2, 2);
+	unsigned int sequence = sram_read(index + 4, 4);
+
+	int i;
+	index += SAVE_HEADER_LEN;
+
+	for (i = 0; i < SAVEFILE_LEN; ++i)
+		save_data[i] = sram_mem[index + i];
+
+	if (save_crc((unsigned char*)save_data, sequence) != crc)
+		return 0;
+
+	save_bank	  = bank;
+	save_sequence = sequence;
+
+	// The other bank is older, so everything has to be written to it
+	for (i = 0; i < SAVE_DIRTY_WORDS; ++i)
+		save_dirty[bank][i] = 0;
+	mark_bank_dirty(bank ^ 1);
+
+	return 1;
+}
+
 void reset_file() {
 	int index;
-	int index2 = SAVE_INDEX;
 
-	for (index = 0; index < SAVEFILE_LEN; ++index) {
-		sram_mem[index + index2] = 0xFF;
-		save_data[index]		 = 0x00;
+	for (index = 0; index < SAVEFILE_LEN; ++index)
+		save_data[index] = 0x00;
+
+	// Wipe out both banks' headers
+	for (index = 0; index < SAVE_HEADER_LEN; ++index) {
+		sram_mem[SAVE_BANK_INDEX(0) + index] = 0xFF;
+		sram_mem[SAVE_BANK_INDEX(1) + index] = 0xFF;
 	}
+
+	save_bank	  = 1;
+	save_sequence = 0;
+	mark_bank_dirty(0);
+	mark_bank_dirty(1);
 }
 void save_file() {
+	int bank			  = save_bank ^ 1;
+	int index			  = SAVE_BANK_INDEX(bank);
+	unsigned int sequence = save_sequence + 1;
 
-	int index;
-	int index2 = SAVE_INDEX;
+	int range, i;
 
-	int* src = &save_data[0];
+	// Write only the ranges that changed since this bank was last written
+	for (range = 0; range < SAVE_RANGES; ++range) {
+		if (!(save_dirty[bank][range >> 5] & (1 << (range & 0x1F))))
+			continue;
 
-	for (index = 0; index < SAVEFILE_LEN; index += 4) {
-		int val = *src;
+		int start = range << SAVE_RANGE_SHIFT;
+		int end	  = start + (1 << SAVE_RANGE_SHIFT);
 
-		debug_flags = val;
+		if (end > SAVEFILE_LEN)
+			end = SAVEFILE_LEN;
 
-		sram_mem[index2] = val;
-		val >>= 8;
-		sram_mem[index2 + 1] = val;
-		val >>= 8;
-		sram_mem[index2 + 2] = val;
-		val >>= 8;
-		sram_mem[index2 + 3] = val;
-
-		index2 += 4;
-		src++;
+		for (i = start; i < end; ++i)
+			sram_mem[index + SAVE_HEADER_LEN + i] = save_data[i];
 	}
+
+	for (i = 0; i < SAVE_DIRTY_WORDS; ++i)
+		save_dirty[bank][i] = 0;
+
+	// The header goes last, so the bank is only valid once all the data made it in
+	sram_write(index, SAVE_MAGIC, 2);
+	sram_write(index + 4, sequence, 4);
+	sram_write(index + 2, save_crc((unsigned char*)save_data, sequence), 2);
+
+	save_bank	  = bank;
+	save_sequence = sequence;
 }
 void load_file() {
+	int first = 0;
 
-	int index  = 0;
-	int index2 = SAVE_INDEX;
+	// Try the newest bank first, and fall back on the other one if it's corrupted
+	if (sram_read(SAVE_BANK_INDEX(1), 2) == SAVE_MAGIC &&
+		(sram_read(SAVE_BANK_INDEX(0), 2) != SAVE_MAGIC ||
+		 (int)(sram_read(SAVE_BANK_INDEX(1) + 4, 4) - sram_read(SAVE_BANK_INDEX(0) + 4, 4)) > 0))
+		first = 1;
 
-	if (sram_mem[index2] == 0xFF) {
-		for (index = 0; index < SAVEFILE_LEN; index += 4) {
-			save_data[index] = 0;
-		}
-		save_file();
-	} else {
-		int* src = &save_data[0];
-		for (index = 0; index < SAVEFILE_LEN; index += 4) {
-			int val = sram_mem[index2];
-			val |= sram_mem[index2 + 1] << 8;
-			val |= sram_mem[index2 + 2] << 16;
-			val |= sram_mem[index2 + 3] << 24;
-			*src = val;
-			src++;
-
-			index2 += 4;
-		}
-	}
+	if (load_bank(first) || load_bank(first ^ 1))
+		return;
+
+	reset_file();
+	save_file();
 }
 void open_file(int file) {
 	save_file_number = file;
@@ -323,11 +591,14 @@ long long_from_file(int index) {
 	return val;
 }
 void char_to_file(int index, char value) {
+	mark_file_dirty(index, 1);
 	save_data[index] = value;
 }
 void short_to_file(int index, short value) {
 	int i;
 
+	mark_file_dirty(index, 2);
+
 	for (i = 0; i < 2; ++i) {
 		save_data[index + i] = value & 0xFF;
 		value >>= 8;
@@ -336,6 +607,8 @@ void short_to_file(int index, short value) {
 void int_to_file(int index, int value) {
 	int i;
 
+	mark_file_dirty(index, 4);
+
 	for (i = 0; i < 4; ++i) {
 		save_data[index + i] = value & 0xFF;
 		value >>= 8;
@@ -344,6 +617,8 @@ void int_to_file(int index, int value) {
 void long_to_file(int index, long value) {
 	int i;
 
+	mark_file_dirty(index, 8);
+
 	for (i = 0; i < 8; ++i) {
 		save_data[index + i] = value & 0xFF;
 		value >>= 8;
@@ -4,6 +4,14 @@
 #include "coroutine.h"
 #include "engine.h"
 
+// Engine hot paths (camera streaming, physics, particles, sprite animation) are placed in IWRAM as ARM code
+// when IWRAM_HOT_PATHS is defined.  Use on both the prototype and the definition, so calls from ROM use long calls
+#ifdef IWRAM_HOT_PATHS
+#define HOT_CODE IWRAM_CODE __attribute__((target("arm")))
+#else
+#define HOT_CODE
+#endif
+
 // ---- ENGINE ----
 //
 extern unsigned int game_life, levelpack_life, level_life;
@@ -30,6 +38,42 @@ extern unsigned int debug_engine_flags, debug_game_flags;
 
 extern unsigned int debug_flags;
 
+#ifdef __DEBUG__
+
+// Engine stats for the editor to read.  Keep in sync with DebugCounter in GameCommunicator.cs
+typedef enum {
+	DCOUNT_DMA_QUEUED,	 // Bytes queued to be copied during VBlank
+	DCOUNT_DMA_CARRIED,	 // VBlanks that ran out of budget and left copies for the next VBlank
+	DCOUNT_DMA_OVERFLOW, // Copies done right away because the queue was full
+	DCOUNT_DMA_PEAK,	 // Most copies waiting in the queue at once
+
+	DCOUNT_SPRITE_ALLOC_FAIL,  // Sprites that didn't fit in sprite VRAM
+	DCOUNT_SPRITE_CACHE_HIT,   // Sprite loads that shared a bank already loaded
+	DCOUNT_SPRITE_CACHE_MISS,  // Sprite loads that needed a new bank
+	DCOUNT_SPRITE_CACHE_EVICT, // Unused banks unloaded to make room
+
+	DCOUNT_AFFINE_SHARED, // Affine sprites that shared a matrix slot
+	DCOUNT_AFFINE_APPROX, // Affine sprites given the closest matrix because every slot was in use
+
+	DEBUG_COUNTER_COUNT,
+} DebugCounter;
+
+extern unsigned int debug_counters[DEBUG_COUNTER_COUNT];
+
+#define DEBUG_COUNT(name, n) (debug_counters[DCOUNT_##name] += (n))
+#define DEBUG_PEAK(name, n)                                    \
+	do {                                                       \
+		if ((unsigned int)(n) > debug_counters[DCOUNT_##name]) \
+			debug_counters[DCOUNT_##name] = (n);               \
+	} while (0)
+
+#else
+
+#define DEBUG_COUNT(name, n)
+#define DEBUG_PEAK(name, n)
+
+#endif
+
 // Enabled when the engine is loading levels async
 #define LOADING_ASYNC
 #define ENG_FLAG_LOADING_ASYNC 0x00000001
@@ -57,11 +101,14 @@ extern void (*custom_render)(void);
 void pixtro_init();
 void pixtro_update();
 void pixtro_render();
+void pixtro_vblank();
 
 // Others
 void open_file(int file);
 void save_file();
 void reset_file();
+// Call after writing to save_data directly, so the range is saved
+void mark_file_dirty(int index, int len);
 
 void save_settings();
 void reset_settings();
@@ -0,0 +1,76 @@
+#include "dma_queue.h"
+#include <string.h>
+
+#include "tonc_vscode.h"
+
+typedef struct {
+	const void* src;
+	void* dst;
+	unsigned int size;
+} DMAJob;
+
+DMAJob dma_jobs[DMA_QUEUE_LEN];
+// The VBlank interrupt only moves the head, and the main loop only moves the tail
+volatile unsigned int dma_head, dma_tail;
+
+void dma_queue_push(void* dst, const void* src, unsigned int size) {
+	if (!size)
+		return;
+
+	unsigned int tail = dma_tail;
+
+	// Queue is full, so just copy it now
+	if (tail - dma_head >= DMA_QUEUE_LEN) {
+		DEBUG_COUNT(DMA_OVERFLOW, 1);
+		dma3_copy_now(dst, src, size >> 2, DMA_CPY32);
+		return;
+	}
+
+	DMAJob* job = &dma_jobs[tail & (DMA_QUEUE_LEN - 1)];
+
+	job->src  = src;
+	job->dst  = dst;
+	job->size = size;
+
+	// The job has to be written before the tail moves, or the interrupt could copy a job that isn't filled in yet.
+	// dma_jobs isn't volatile, so stop the compiler from moving the writes past this
+	__asm__ volatile("" ::: "memory");
+
+	dma_tail = tail + 1;
+
+	DEBUG_COUNT(DMA_QUEUED, size);
+	DEBUG_PEAK(DMA_PEAK, dma_tail - dma_head);
+}
+int dma_queue_count() {
+	return dma_tail - dma_head;
+}
+
+void dma_queue_vblank() {
+	unsigned int head	= dma_head;
+	unsigned int budget = DMA_QUEUE_BUDGET;
+
+	while (head != dma_tail) {
+		DMAJob* job = &dma_jobs[head & (DMA_QUEUE_LEN - 1)];
+
+		// Copy what fits in this VBlank, and leave the rest of the job for the next one
+		if (job->size > budget) {
+			if (budget) {
+				dma3_cpy(job->dst, job->src, budget);
+
+				job->src = (const char*)job->src + budget;
+				job->dst = (char*)job->dst + budget;
+				job->size -= budget;
+			}
+
+			DEBUG_COUNT(DMA_CARRIED, 1);
+			break;
+		}
+
+		dma3_cpy(job->dst, job->src, job->size);
+		budget -= job->size;
+
+		head++;
+	}
+
+	dma_head = head;
+}
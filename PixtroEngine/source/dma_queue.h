@@ -0,0 +1,35 @@
+#pragma once
+
+#include "core.h"
+
+// ---- VBlank transfer queue ----
+//
+// Copies to VRAM can be queued up at any point in the frame, and are done with DMA at the start of VBlank.
+// Each VBlank copies up to DMA_QUEUE_BUDGET bytes, and anything left over carries on to the next VBlank.
+// The source data has to stay the same until it's been copied
+
+// Max amount of bytes copied per VBlank
+#ifndef DMA_QUEUE_BUDGET
+#define DMA_QUEUE_BUDGET 6144
+#endif
+
+// Max amount of copies waiting at once.  Must be a power of 2
+#define DMA_QUEUE_LEN 64
+
+// Copy with DMA3 right away, from outside of VBlank.  The VBlank interrupt uses DMA3 too, so interrupts are off while
+// the registers are set up, or the copy could run with the interrupt's addresses.  `count` is in units of `mode`,
+// the same as tonc's dma_cpy
+static inline void dma3_copy_now(void* dst, const void* src, unsigned int count, unsigned int mode) {
+	unsigned short ime = REG_IME;
+
+	REG_IME = 0;
+	dma_cpy(dst, src, count, 3, mode);
+	REG_IME = ime;
+}
+
+// Queue a copy.  Size is in bytes, and should be a multiple of 4.  If the queue is full, the copy is done right away
+void dma_queue_push(void* dst, const void* src, unsigned int size);
+// Amount of copies still waiting
+int dma_queue_count();
+
+void dma_queue_vblank();
@@ -0,0 +1,140 @@
+#include "entities.h"
+
+#include "core.h"
+#include "physics.h"
+
+EntityList active_entities, visible_entities, detect_entities, free_entities;
+
+unsigned char entity_update_period[32], entity_update_phase[32];
+unsigned char entity_update_timer[ENTITY_LIMIT];
+unsigned short entity_last_update[ENTITY_LIMIT];
+unsigned int entity_frames_elapsed;
+
+unsigned char entity_layers[ENTITY_LIMIT];
+unsigned short entity_hit_mask[ENTITY_LIMIT];
+
+// Counts entities spawned per type, to spread them out over their update period
+unsigned char entity_spread[32];
+
+void entity_list_add(EntityList* list, unsigned int index) {
+	if (list->position[index] != ENT_LIST_NONE)
+		return;
+
+	list->position[index]	   = list->count;
+	list->items[list->count++] = index;
+}
+void entity_list_remove(EntityList* list, unsigned int index) {
+	unsigned int pos = list->position[index];
+
+	if (pos == ENT_LIST_NONE)
+		return;
+
+	// Move the last entity into the empty spot to keep the list packed
+	unsigned int last = list->items[--list->count];
+
+	list->items[pos]	  = last;
+	list->position[last]  = pos;
+	list->position[index] = ENT_LIST_NONE;
+}
+void entity_list_set(EntityList* list, unsigned int index, int enabled) {
+	if (enabled)
+		entity_list_add(list, index);
+	else
+		entity_list_remove(list, index);
+}
+
+// Update which lists an entity is in based on its flags
+void refresh_entity(unsigned int index) {
+	unsigned int id = ENT_ID(index);
+
+	int loaded	= (id & ENT_LOADED_FLAG) != 0;
+	int active	= loaded && (id & ENT_ACTIVE_FLAG);
+	int visible = loaded && (id & ENT_VISIBLE_FLAG);
+	int detect	= active && (id & ENT_DETECT_FLAG);
+
+	entity_list_set(&active_entities, index, active);
+	entity_list_set(&visible_entities, index, visible);
+	entity_list_set(&detect_entities, index, detect);
+	entity_list_set(&free_entities, index, !loaded);
+}
+
+// Rebuild every list from scratch.  Used after entities get moved around in memory
+void reset_entity_lists() {
+	int i;
+
+	active_entities.count  = 0;
+	visible_entities.count = 0;
+	detect_entities.count  = 0;
+	free_entities.count	   = 0;
+
+	for (i = 0; i < ENTITY_LIMIT; ++i) {
+		active_entities.position[i]	 = ENT_LIST_NONE;
+		visible_entities.position[i] = ENT_LIST_NONE;
+		detect_entities.position[i]	 = ENT_LIST_NONE;
+		free_entities.position[i]	 = ENT_LIST_NONE;
+	}
+
+	// Go backwards so the lowest free slots are at the end of the free list, and get used first
+	for (i = ENTITY_LIMIT - 1; i >= 0; --i) {
+		refresh_entity(i);
+	}
+}
+
+// Take an unused entity slot.  Returns -1 if every slot is taken
+int alloc_entity() {
+	if (!free_entities.count)
+		return -1;
+
+	int index = free_entities.items[free_entities.count - 1];
+	entity_list_remove(&free_entities, index);
+
+	return index;
+}
+
+// Unload an entity and give its slot back to the free list
+void remove_entity(unsigned int index) {
+	ENT_ID(index) = 0;
+	refresh_entity(index);
+}
+
+// Copy an entity into another slot.  Doesn't update the entity lists
+void move_entity(unsigned int dst, unsigned int src) {
+#ifdef ENTITY_SOA
+	int i;
+
+	entity_x[dst]	   = entity_x[src];
+	entity_y[dst]	   = entity_y[src];
+	entity_vel_x[dst]  = entity_vel_x[src];
+	entity_vel_y[dst]  = entity_vel_y[src];
+	entity_width[dst]  = entity_width[src];
+	entity_height[dst] = entity_height[src];
+	entity_id[dst]	   = entity_id[src];
+
+	for (i = 0; i < 6; ++i)
+		entity_data[dst][i] = entity_data[src][i];
+#else
+	entities[dst] = entities[src];
+#endif
+
+	entity_layers[dst]	 = entity_layers[src];
+	entity_hit_mask[dst] = entity_hit_mask[src];
+
+	// Keep its place in the update schedule, and whether it's resting
+	entity_update_timer[dst] = entity_update_timer[src];
+	entity_last_update[dst]	 = entity_last_update[src];
+
+	move_entity_rest(dst, src);
+}
+
+// Set up when a newly spawned entity will first update
+void schedule_entity(unsigned int index) {
+	int type   = ENT_TYPE(index);
+	int period = entity_update_period[type];
+
+	entity_last_update[index] = game_life;
+
+	if (period > 1)
+		entity_update_timer[index] = (entity_update_phase[type] + entity_spread[type]++) % period;
+	else
+		entity_update_timer[index] = 0;
+}
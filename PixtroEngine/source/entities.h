@@ -19,11 +19,44 @@ typedef struct
 	unsigned int flags[6];
 } ALIGN4 Entity;
 
-#define ENT_TYPE(n) (entities[n].ID & 0x1F)
+#ifdef ENTITY_SOA
 
-#define ENT_FLAG(name, n)		  (entities[n].ID & ENT_##name##_FLAG)
-#define ENABLE_ENT_FLAG(name, n)  entities[n].ID |= ENT_##name##_FLAG
-#define DISABLE_ENT_FLAG(name, n) entities[n].ID &= ~(ENT_##name##_FLAG)
+// The fields read every frame are kept in their own packed arrays, and the user data is kept apart from them.
+// The Entity struct isn't used for storage in this mode, so use the macros below to access entities.
+extern int entity_x[ENTITY_LIMIT], entity_y[ENTITY_LIMIT], entity_vel_x[ENTITY_LIMIT], entity_vel_y[ENTITY_LIMIT];
+extern unsigned short entity_width[ENTITY_LIMIT], entity_height[ENTITY_LIMIT];
+extern unsigned int entity_id[ENTITY_LIMIT];
+extern unsigned int entity_data[ENTITY_LIMIT][6];
+
+#define ENT_X(n)		 (entity_x[n])
+#define ENT_Y(n)		 (entity_y[n])
+#define ENT_VEL_X(n)	 (entity_vel_x[n])
+#define ENT_VEL_Y(n)	 (entity_vel_y[n])
+#define ENT_WIDTH(n)	 (entity_width[n])
+#define ENT_HEIGHT(n)	 (entity_height[n])
+#define ENT_ID(n)		 (entity_id[n])
+#define ENT_DATA(n, idx) (entity_data[n][idx])
+
+#else
+
+extern Entity entities[ENTITY_LIMIT];
+
+#define ENT_X(n)		 (entities[n].x)
+#define ENT_Y(n)		 (entities[n].y)
+#define ENT_VEL_X(n)	 (entities[n].vel_x)
+#define ENT_VEL_Y(n)	 (entities[n].vel_y)
+#define ENT_WIDTH(n)	 (entities[n].width)
+#define ENT_HEIGHT(n)	 (entities[n].height)
+#define ENT_ID(n)		 (entities[n].ID)
+#define ENT_DATA(n, idx) (entities[n].flags[idx])
+
+#endif
+
+#define ENT_TYPE(n) (ENT_ID(n) & 0x1F)
+
+#define ENT_FLAG(name, n)		  (ENT_ID(n) & ENT_##name##_FLAG)
+#define ENABLE_ENT_FLAG(name, n)  (ENT_ID(n) |= ENT_##name##_FLAG, refresh_entity(n))
+#define DISABLE_ENT_FLAG(name, n) (ENT_ID(n) &= ~(ENT_##name##_FLAG), refresh_entity(n))
 
 // If enabled, this entity won't be unloaded when moving between levels
 #define PERSISTENT
@@ -50,11 +83,91 @@ typedef struct
 	entity_update[i] = &name##_update; \
 	entity_render[i] = &name##_render
 
+// Same as LOAD_ENTITY, but the entity type only updates once every `period` frames.
+// Entities of the type are spread out over those frames, starting `phase` frames in.
+#define LOAD_ENTITY_RATE(name, i, period, phase) \
+	LOAD_ENTITY(name, i);                        \
+	SET_ENTITY_RATE(i, period, phase)
+
+#define SET_ENTITY_RATE(i, period, phase) \
+	entity_update_period[i] = (period);   \
+	entity_update_phase[i]	= (phase)
+
 extern unsigned int max_entities;
 
 extern int (*entity_inits[32])(unsigned int actor_index, unsigned char* data, unsigned char* is_loading);
-extern Entity entities[ENTITY_LIMIT];
 extern void (*entity_update[32])(unsigned int index);
 extern void (*entity_render[32])(unsigned int index);
 
-void unload_entity(Entity* ent);
\ No newline at end of file
+// ---- Update scheduling ----
+// Entity types with an update period above 1 are low priority.  They only update once per period, after every other
+// entity, and are pushed to the next frame if the entity updates have used up ENTITY_UPDATE_BUDGET cycles.  The ones
+// pushed back go first next frame.
+
+// The max amount of cycles entity updates can use before low priority entities are put off to the next frame
+#ifndef ENTITY_UPDATE_BUDGET
+#define ENTITY_UPDATE_BUDGET 160000
+#endif
+
+extern unsigned char entity_update_period[32], entity_update_phase[32];
+// Frames until each entity's next update
+extern unsigned char entity_update_timer[ENTITY_LIMIT];
+extern unsigned short entity_last_update[ENTITY_LIMIT];
+// The amount of frames since the entity being updated last updated.  Use to scale movement for slow update rates
+extern unsigned int entity_frames_elapsed;
+
+void schedule_entity(unsigned int index);
+
+// ---- Collision layers ----
+// Each entity is on up to 8 layers, used to filter broadphase queries.  Entities start on ENT_LAYER_DEFAULT when spawned
+
+#define ENT_LAYER_DEFAULT 0x01
+#define ENT_LAYER_ALL	  0xFF
+
+#define ENT_LAYERS(n) (entity_layers[n])
+
+extern unsigned char entity_layers[ENTITY_LIMIT];
+
+// The collision types an entity hits when using physics_step_all.  Entities start with ENT_HIT_DEFAULT
+#define ENT_HIT_DEFAULT 0x0001
+
+#define ENT_HIT_MASK(n) (entity_hit_mask[n])
+
+extern unsigned short entity_hit_mask[ENTITY_LIMIT];
+
+// ---- Entity lists ----
+// Packed lists of entity indexes, so the update, render and collision loops only touch live entities.
+// Kept up to date when an entity is loaded, unloaded, or has a flag changed through ENABLE/DISABLE_ENT_FLAG.
+// If you change an entity's ID by hand, call refresh_entity() afterwards.
+
+typedef struct
+{
+	unsigned int count;
+	unsigned short items[ENTITY_LIMIT];
+	// Where each entity is in `items`, or ENT_LIST_NONE if it isn't in this list
+	unsigned short position[ENTITY_LIMIT];
+} EntityList;
+
+#define ENT_LIST_NONE 0xFFFF
+
+#define ENT_IN_LIST(list, n) (list.position[n] != ENT_LIST_NONE)
+
+// Loaded and active entities
+extern EntityList active_entities;
+// Loaded and visible entities
+extern EntityList visible_entities;
+// Loaded, active and detectable entities
+extern EntityList detect_entities;
+// Unused entity slots.  add_entity() takes from the end of this list
+extern EntityList free_entities;
+
+void refresh_entity(unsigned int index);
+void reset_entity_lists();
+int alloc_entity();
+void remove_entity(unsigned int index);
+void move_entity(unsigned int dst, unsigned int src);
+
+void unload_entity_at(unsigned int index);
+#ifndef ENTITY_SOA
+void unload_entity(Entity* ent);
+#endif
\ No newline at end of file
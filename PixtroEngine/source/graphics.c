@@ -2,19 +2,18 @@
 #include <string.h>
 
 #include "core.h"
+#include "dma_queue.h"
 #include "graphics.h"
 #include "load_data.h"
+#include "palette.h"
+#include "scanline.h"
 
 #define copyTile	32
 #define copyPalette 32
 
 #define tileSize 8
 
-// Max of 128 sprites
-#define SPRITE_LIMIT 128
-
-#define BANK_LIMIT	   64
-#define BANK_MEM_START 0x60
+#define BANK_LIMIT 64
 
 int drawing_flags = DFLAG_CAM_FOLLOW | DFLAG_CAM_BOUNDS;
 int cam_x, cam_y, prev_cam_x, prev_cam_y;
@@ -22,6 +21,12 @@ int cam_x, cam_y, prev_cam_x, prev_cam_y;
 unsigned short colorbank[512];
 
 char is_rendering;
+// Set once obj_buffer is finished, so it can be copied into OAM during VBlank
+volatile char oam_ready;
+// The scroll of each layer, copied into the background registers along with OAM
+unsigned short bg_scroll[8] ALIGN4;
+
+#define BGOFS ((vu32*)(REG_BASE + 0x0010))
 
 #define LAYER_META_INIT(index, t, vis) ((index << LAYER_INDEX_SHIFT) | LAYER_TYPE(t) | LAYER_VISIBLE(vis))
 
@@ -83,118 +88,370 @@ int affine_count;
 
 #define UNLOADED_SPRITE 0xFF
 
-#define TILE_INFO ((unsigned short*)0x02020000)
-
 // Sprite bank information
 char shapes[BANK_LIMIT];
-int sprite_indexes[BANK_LIMIT], ordered[BANK_LIMIT];
+int sprite_indexes[BANK_LIMIT];
+// The amount of tiles allocated to each bank, which can be more than the shape loaded uses
+unsigned short sprite_tiles[BANK_LIMIT];
+// Offset from the bank's tiles to the current animation frame, for animations kept entirely in VRAM
+unsigned short sprite_frame_tile[BANK_LIMIT];
+
+// Animation frames are all kept in VRAM if there would still be this many free tiles left over
+#ifndef ANIM_VRAM_RESERVE
+#define ANIM_VRAM_RESERVE 128
+#endif
+
+#define ANIM_RESIDENT 0x100000
+
+unsigned int *anim_bank[BANK_LIMIT], anim_meta[BANK_LIMIT];
+
+// ---- Sprite cache ----
+// Banks loaded with load_sprite and load_anim_sprite remember where their graphics came from, so loading the same
+// graphics again shares the bank.  Banks nobody is using stay loaded until the space is needed, and then the bank
+// drawn least recently is unloaded first
 
-unsigned int *anim_bank[BANK_LIMIT], anim_meta[BANK_LIMIT], wait_to_load[BANK_LIMIT];
+// The graphics each bank was loaded from, or NULL for banks loaded to a specific index
+unsigned int* sprite_source[BANK_LIMIT];
+// Shape and animation settings each bank was loaded with
+unsigned int sprite_config[BANK_LIMIT];
+unsigned char sprite_refs[BANK_LIMIT];
+unsigned int sprite_last_drawn[BANK_LIMIT];
+
+#define SPRITE_CONFIG(shape, frames, speed, anim) ((shape) | ((frames) << 8) | ((speed) << 16) | ((anim) << 24))
+
+void upload_sprite(unsigned int* sprite, int index, int shape);
+void free_sprite_bank(int index);
 
 OBJ_ATTR obj_buffer[SPRITE_LIMIT];
 OBJ_ATTR* sprite_pointer;
 OBJ_AFFINE* obj_aff_buffer = (OBJ_AFFINE*)obj_buffer;
 
-extern void load_tiletypes(unsigned int* coll_data);
+extern void load_tile_shapes(const unsigned char* profiles);
 
-int load_sprite(unsigned int* sprite, int shape) {
-	int value = 0;
+// ---- Sprite VRAM allocation ----
+// One bit for each tile in sprite VRAM, set if the tile is in use.  The highest bit of each word is the lowest tile
 
-	for (; value < BANK_LIMIT; ++value) {
-		if (shapes[value] == UNLOADED_SPRITE) {
-			load_sprite_at(sprite, value, shape);
-			return value;
-		}
+#define OBJ_TILES	  1024
+#define OBJ_TILE_MASK 0x1F
+
+unsigned int obj_tile_map[OBJ_TILES >> 5];
+int obj_tiles_free;
+
+// Set or clear a run of tiles in the map.  A sprite covers at most 3 words, so this doesn't depend on size
+void set_obj_tiles(int tile, int count, int used) {
+	while (count > 0) {
+		int shift = tile & OBJ_TILE_MASK;
+		int len	  = 32 - shift;
+
+		if (len > count)
+			len = count;
+
+		unsigned int mask = (len == 32) ? 0xFFFFFFFF : ((0xFFFFFFFF << (32 - len)) >> shift);
+
+		if (used)
+			obj_tile_map[tile >> 5] |= mask;
+		else
+			obj_tile_map[tile >> 5] &= ~mask;
+
+		tile += len;
+		count -= len;
 	}
-	return -1;
 }
-int load_anim_sprite(unsigned int* sprites, int shape, int frames, int speed) {
-	int value = 0;
+// The amount of free tiles in a row, starting at `tile`.  Stops counting once past `max`
+int free_tile_run(int tile, int max) {
+	int count = 0;
+
+	while (count < max && tile < OBJ_TILES) {
+		unsigned int bits = obj_tile_map[tile >> 5] << (tile & OBJ_TILE_MASK);
+		int run			  = bits ? __builtin_clz(bits) : 32 - (tile & OBJ_TILE_MASK);
+
+		count += run;
+		tile += run;
+
+		if (bits)
+			break;
+	}
+
+	return count;
+}
+// The amount of used tiles in a row, starting at `tile`
+int used_tile_run(int tile) {
+	int count = 0;
+
+	while (tile < OBJ_TILES) {
+		unsigned int bits = ~obj_tile_map[tile >> 5] << (tile & OBJ_TILE_MASK);
+		int run			  = bits ? __builtin_clz(bits) : 32 - (tile & OBJ_TILE_MASK);
 
-	for (; value < BANK_LIMIT; ++value) {
-		if (shapes[value] == UNLOADED_SPRITE) {
-			load_anim_sprite_at(sprites, value, shape, frames, speed);
-			return value;
+		count += run;
+		tile += run;
+
+		if (bits)
+			break;
+	}
+
+	return count;
+}
+// Find the first run of free tiles big enough, returns -1 if there isn't one
+int alloc_obj_tiles(int count) {
+	if (count > obj_tiles_free)
+		return -1;
+
+	int tile = BANK_MEM_START;
+
+	while (tile + count <= OBJ_TILES) {
+		int run = free_tile_run(tile, count);
+
+		if (run >= count) {
+			set_obj_tiles(tile, count, 1);
+			obj_tiles_free -= count;
+			return tile;
 		}
+
+		tile += run;
+		tile += used_tile_run(tile);
 	}
+
 	return -1;
 }
-void load_sprite_at(unsigned int* sprite, int index, int shape) {
-	if (!is_rendering) {
-		wait_to_load[index] = ((unsigned int)sprite) | (shape << 28);
-		shapes[index]		= 0xF0; // Set to distinct value to prevent rewriting, but not a valid shape value
-		return;
+void free_obj_tiles(int tile, int count) {
+	set_obj_tiles(tile, count, 0);
+	obj_tiles_free += count;
+}
+void reset_obj_tiles() {
+	int i;
+
+	for (i = 0; i < OBJ_TILES >> 5; ++i)
+		obj_tile_map[i] = 0;
+
+	// Particles use the tiles before the sprite banks
+	set_obj_tiles(0, BANK_MEM_START, 1);
+	obj_tiles_free = OBJ_TILES - BANK_MEM_START;
+}
+
+int sprite_tiles_free() {
+	return obj_tiles_free;
+}
+int sprite_largest_free() {
+	int tile = BANK_MEM_START, largest = 0;
+
+	while (tile < OBJ_TILES) {
+		int run = free_tile_run(tile, OBJ_TILES);
+
+		if (run > largest)
+			largest = run;
+
+		tile += run;
+		tile += used_tile_run(tile);
 	}
 
-	anim_bank[index] = NULL;
+	return largest;
+}
+
+// Move loaded sprites down into the gaps between them, so larger sprites can fit.  Each call moves up to
+// DMA_QUEUE_BUDGET bytes of sprites, and the copies and new tile indexes take effect in the same VBlank.  Banks
+// bigger than that never move.  Returns 1 once there's nothing left to move
+int compact_sprites() {
+	// Copies still waiting might be going to tiles about to be moved
+	if (dma_queue_count())
+		return 0;
 
-	int bankLoc, size = shape2size[shape];
+	unsigned char order[BANK_LIMIT];
+	int count = 0, i, j;
 
-	// If there's a sprite already loaded here, and it's the same size or bigger, replace it
-	if (shapes[index] < 12 && shape2size[shapes[index]] >= size) {
-		bankLoc = sprite_indexes[index];
-	} else {
-		int i;
-		bankLoc = BANK_MEM_START;
+	// Sort loaded banks by their position in VRAM
+	for (i = 0; i < BANK_LIMIT; ++i) {
+		if (shapes[i] >= 12)
+			continue;
 
-		// Search for an open spot in the sprites
-		for (i = 0; i < BANK_LIMIT; ++i) {
+		for (j = count; j > 0 && sprite_indexes[order[j - 1]] > sprite_indexes[i]; --j)
+			order[j] = order[j - 1];
 
-			int diff = sprite_indexes[ordered[i + 1]] - sprite_indexes[ordered[i]];
+		order[j] = i;
+		count++;
+	}
 
-			if (shapes[ordered[i]] < 12) {
-				diff -= shape2size[shapes[ordered[i]]] >> 5;
-			}
+	int tile = BANK_MEM_START, budget = DMA_QUEUE_BUDGET;
 
-			if (diff >= size >> 5) {
-				bankLoc = sprite_indexes[ordered[i]];
+	for (i = 0; i < count; ++i) {
+		int bank = order[i];
+		int from = sprite_indexes[bank], len = sprite_tiles[bank];
 
-				if (shapes[ordered[i]] < 12)
-					bankLoc += shape2size[shapes[ordered[i]]] >> 5;
+		// Banks too big to copy in one VBlank are left where they are, and everything after them packs in behind
+		if (from != tile && len << 5 > DMA_QUEUE_BUDGET)
+			tile = from;
 
-				break;
+		if (from != tile) {
+			if (len << 5 > budget)
+				return 0;
+			budget -= len << 5;
+
+			free_obj_tiles(from, len);
+			set_obj_tiles(tile, len, 1);
+			obj_tiles_free -= len;
+
+			dma_queue_push(&tile_mem[4][tile], &tile_mem[4][from], len << 5);
+
+			// Point any sprites waiting to go into OAM at the new tiles
+			for (j = 0; j < SPRITE_LIMIT; ++j) {
+				int index = obj_buffer[j].attr2 & ATTR2_ID_MASK;
+
+				if (index >= from && index < from + len)
+					obj_buffer[j].attr2 += tile - from;
 			}
+
+			sprite_indexes[bank] = tile;
 		}
-		sprite_indexes[index] = bankLoc & 0x7FFF;
 
-		bool swapping = false;
+		tile += len;
+	}
 
-		// Find index in ordered list
-		// Check if out of order:
-		// if ind-1 is bigger than ind, move ind backward to sort
-		// if ind+1 is smaller than ind, move ind forward to sort
+	return 1;
+}
 
-		// I have no clue if this works, and I don't know how to test it, so we'll just pretend this works
-		int ind;
-		for (ind = BANK_LIMIT; ind >= 0; --ind) {
+// Unload the bank drawn least recently that nothing is using.  Returns the bank, or -1 if there isn't one
+int evict_sprite() {
+	int i, oldest = -1;
 
-			if (ordered[ind] == index) {
-				break;
-			}
+	for (i = 0; i < BANK_LIMIT; ++i) {
+		if (!sprite_source[i] || sprite_refs[i] || shapes[i] == UNLOADED_SPRITE)
+			continue;
+
+		if (oldest < 0 || game_life - sprite_last_drawn[i] > game_life - sprite_last_drawn[oldest])
+			oldest = i;
+	}
+
+	if (oldest >= 0) {
+		DEBUG_COUNT(SPRITE_CACHE_EVICT, 1);
+		free_sprite_bank(oldest);
+	}
+
+	return oldest;
+}
+int load_cached_sprite(unsigned int* sprite, int shape, int frames, int speed, int anim) {
+	unsigned int config = SPRITE_CONFIG(shape, frames, speed, anim);
+	int index;
+
+	for (index = 0; index < BANK_LIMIT; ++index) {
+		if (sprite_source[index] == sprite && sprite_config[index] == config && shapes[index] != UNLOADED_SPRITE) {
+			DEBUG_COUNT(SPRITE_CACHE_HIT, 1);
+
+			sprite_refs[index]++;
+			return index;
 		}
+	}
 
-		while (ind > 0 && sprite_indexes[ordered[ind - 1]] > bankLoc) {
-			int temp		 = ordered[ind - 1];
-			ordered[ind - 1] = index;
-			ordered[ind]	 = temp;
+	DEBUG_COUNT(SPRITE_CACHE_MISS, 1);
 
-			ind--;
+	while (1) {
+		for (index = 0; index < BANK_LIMIT; ++index) {
+			if (shapes[index] == UNLOADED_SPRITE)
+				break;
 		}
-		while (ind < BANK_LIMIT - 1 && sprite_indexes[ordered[ind + 1]] < bankLoc) {
-			int temp		 = ordered[ind + 1];
-			ordered[ind + 1] = index;
-			ordered[ind]	 = temp;
 
-			ind--;
+		if (index == BANK_LIMIT && (index = evict_sprite()) < 0)
+			return -1;
+
+		if (anim)
+			load_anim_sprite_at(sprite, index, shape, frames, speed);
+		else
+			load_sprite_at(sprite, index, shape);
+
+		if (shapes[index] != UNLOADED_SPRITE)
+			break;
+
+		// Not enough room in VRAM, so make some
+		if (evict_sprite() < 0)
+			return -1;
+	}
+
+	sprite_source[index]	 = sprite;
+	sprite_config[index]	 = config;
+	sprite_refs[index]		 = 1;
+	sprite_last_drawn[index] = game_life;
+
+	return index;
+}
+
+int load_sprite(unsigned int* sprite, int shape) {
+	return load_cached_sprite(sprite, shape, 0, 0, 0);
+}
+int load_anim_sprite(unsigned int* sprites, int shape, int frames, int speed) {
+	return load_cached_sprite(sprites, shape, frames, speed, 1);
+}
+// Loading to a specific bank skips the cache
+void load_sprite_at(unsigned int* sprite, int index, int shape) {
+	sprite_source[index] = NULL;
+	sprite_refs[index]	 = 0;
+
+	upload_sprite(sprite, index, shape);
+}
+void upload_sprite(unsigned int* sprite, int index, int shape) {
+	anim_bank[index]		 = NULL;
+	sprite_frame_tile[index] = 0;
+
+	int bankLoc, size = shape2size[shape];
+
+	// If there's a sprite already loaded here, and it's the same size or bigger, replace it
+	if (shapes[index] < 12 && sprite_tiles[index] >= size >> 5) {
+		bankLoc = sprite_indexes[index];
+	} else {
+		if (shapes[index] < 12)
+			free_obj_tiles(sprite_indexes[index], sprite_tiles[index]);
+
+		bankLoc = alloc_obj_tiles(size >> 5);
+
+		if (bankLoc < 0) {
+			DEBUG_COUNT(SPRITE_ALLOC_FAIL, 1);
+
+			shapes[index]		  = UNLOADED_SPRITE;
+			sprite_indexes[index] = 0x8000;
+			return;
 		}
+
+		sprite_indexes[index] = bankLoc;
+		sprite_tiles[index]	  = size >> 5;
 	}
 
 	shapes[index] = shape;
 
-	memcpy(&tile_mem[4][bankLoc], sprite, size);
+	dma_queue_push(&tile_mem[4][bankLoc], sprite, size);
+}
+// Upload every frame of an animation at once, so changing frames only changes the tile index.  Returns 0 if there
+// isn't enough VRAM to spare
+int load_resident_anim(unsigned int* sprites, int index, int shape, int frames) {
+	int tiles = (shape2size[shape] >> 5) * frames;
+
+	if (obj_tiles_free - tiles < ANIM_VRAM_RESERVE)
+		return 0;
+
+	if (shapes[index] < 12)
+		free_obj_tiles(sprite_indexes[index], sprite_tiles[index]);
+
+	int bankLoc = alloc_obj_tiles(tiles);
+
+	if (bankLoc < 0) {
+		shapes[index]		  = UNLOADED_SPRITE;
+		sprite_indexes[index] = 0x8000;
+		return 0;
+	}
+
+	shapes[index]			 = shape;
+	sprite_indexes[index]	 = bankLoc;
+	sprite_tiles[index]		 = tiles;
+	sprite_frame_tile[index] = 0;
+
+	dma_queue_push(&tile_mem[4][bankLoc], sprites, tiles << 5);
+
+	return 1;
 }
 void load_anim_sprite_at(unsigned int* sprites, int index, int shape, int frames, int speed) {
-	load_sprite_at(sprites, index, shape);
+	int resident = frames > 1 && frames <= 16 && load_resident_anim(sprites, index, shape, frames);
+
+	sprite_source[index] = NULL;
+	sprite_refs[index]	 = 0;
+
+	if (!resident)
+		upload_sprite(sprites, index, shape);
 
 	anim_bank[index] = sprites;
 
@@ -209,6 +466,9 @@ void load_anim_sprite_at(unsigned int* sprites, int index, int shape, int frames
 	anim_meta[index] |= frames << 12;
 
 	anim_meta[index] |= shape << 16;
+
+	if (resident)
+		anim_meta[index] |= ANIM_RESIDENT;
 }
 
 int get_anim_frame(int anim) {
@@ -230,36 +490,114 @@ int get_anim_time(int anim) {
 	return speed + (anim_meta[anim] & 0xF);
 }
 
-void unload_sprite(int index) {
-	shapes[index] = UNLOADED_SPRITE;
+void free_sprite_bank(int index) {
+	if (shapes[index] < 12)
+		free_obj_tiles(sprite_indexes[index], sprite_tiles[index]);
+
+	shapes[index]			 = UNLOADED_SPRITE;
+	sprite_indexes[index]	 = 0x8000;
+	sprite_frame_tile[index] = 0;
+	anim_bank[index]		 = NULL;
+	sprite_source[index]	 = NULL;
+	sprite_refs[index]		 = 0;
 }
+// Cached banks stay loaded once nothing uses them, until the space is needed
+void unload_sprite(int index) {
+	if (sprite_source[index]) {
+		if (sprite_refs[index])
+			sprite_refs[index]--;
+		return;
+	}
 
-#ifdef LARGE_TILES
-void load_tileset(unsigned int* tiles, unsigned short* mapping, unsigned int* collision, int count, int uvcount) {
-	memcpy(&tile_mem[FG_TILESET][1], tiles, count << 7);
-	memcpy(TILE_INFO + 1, mapping, uvcount << 3);
-	load_tiletypes(collision);
+	free_sprite_bank(index);
 }
-#else
-void load_tileset(unsigned int* tiles, unsigned short* mapping, unsigned int* collision, int count, int uvcount) {
-	memcpy(&tile_mem[FG_TILESET][1], tiles, count << 5);
-	memcpy(TILE_INFO + 1, mapping, uvcount << 1);
-	load_tiletypes(collision);
+
+// Levels already store the final screenblock entries, so only the tiles themselves need loading
+void load_tileset(unsigned int* tiles, const unsigned char* shapes, int count) {
+	dma_queue_push(&tile_mem[FG_TILESET][1], tiles, count << 5);
+	load_tile_shapes(shapes);
 }
-#endif
 void load_obj_pal(unsigned short* pal, int palIndex) {
-	memcpy(&pal_obj_mem[palIndex << 4], pal, copyPalette);
 	memcpy(&colorbank[(palIndex << 4) + 256], pal, copyPalette);
+	refresh_palette_bank(PAL_OBJ_BANK(palIndex));
 }
 void load_bg_pal(unsigned short* pal, int palIndex) {
-	memcpy(&pal_bg_mem[palIndex << 4], pal, copyPalette);
 	memcpy(&colorbank[palIndex << 4], pal, copyPalette);
+	refresh_palette_bank(PAL_BG_BANK(palIndex));
 }
 
-void draw_affine_big(AffineMatrix matrix, int sprite, int prio, int pal) {
-	if (affine_count == 32)
-		return;
+// ---- Affine matrices ----
+// Sprites with the same final matrix share a slot.  Slots are found through a hash table that's cleared every frame
+// by moving on to a new generation.  Once all 32 slots are in use, sprites get the closest matrix already set
+
+#define AFFINE_SLOTS	32
+#define AFFINE_BUCKETS	64
+#define AFFINE_HASH(a, b) ((((a) ^ ((b)*0x9E3779B1)) * 0x9E3779B1) >> 26)
+
+// PA and PB, PC and PD of each slot packed into words
+unsigned int affine_keys[AFFINE_SLOTS][2];
+unsigned int affine_bucket_gen[AFFINE_BUCKETS], affine_gen = 1;
+unsigned char affine_bucket_slot[AFFINE_BUCKETS];
+
+int affine_slot(int pa, int pb, int pc, int pd) {
+	unsigned int key_a = (pa & 0xFFFF) | (pb << 16), key_b = (pc & 0xFFFF) | (pd << 16);
+	int bucket = AFFINE_HASH(key_a, key_b), slot;
+
+	// Tables only ever fill halfway, so there's always an empty bucket to stop on
+	while (affine_bucket_gen[bucket] == affine_gen) {
+		slot = affine_bucket_slot[bucket];
+
+		if (affine_keys[slot][0] == key_a && affine_keys[slot][1] == key_b) {
+			DEBUG_COUNT(AFFINE_SHARED, 1);
+			return slot;
+		}
+
+		bucket = (bucket + 1) & (AFFINE_BUCKETS - 1);
+	}
+
+	if (affine_count < AFFINE_SLOTS) {
+		slot = affine_count++;
+
+		affine_keys[slot][0]	   = key_a;
+		affine_keys[slot][1]	   = key_b;
+		affine_bucket_gen[bucket]  = affine_gen;
+		affine_bucket_slot[bucket] = slot;
+
+		obj_aff_set((obj_aff_buffer + slot), pa, pb, pc, pd);
+		return slot;
+	}
+
+	// Out of slots, so use whichever matrix is closest
+	int best = 0, best_diff = 0x7FFFFFFF;
+
+	for (slot = 0; slot < AFFINE_SLOTS; ++slot) {
+		int diff = INT_ABS((short)affine_keys[slot][0] - pa) + INT_ABS((short)(affine_keys[slot][0] >> 16) - pb) +
+				   INT_ABS((short)affine_keys[slot][1] - pc) + INT_ABS((short)(affine_keys[slot][1] >> 16) - pd);
+
+		if (diff < best_diff) {
+			best	  = slot;
+			best_diff = diff;
+		}
+	}
+
+	DEBUG_COUNT(AFFINE_APPROX, 1);
+	return best;
+}
+// Get the slot for the inverse of a sprite's matrix
+int submit_affine(AffineMatrix* matrix) {
+	int det = FIXED_MULT(matrix->values[0], matrix->values[4]) -
+			  FIXED_MULT(matrix->values[1], matrix->values[3]);
 
+	if (det)
+		det = fixed_reciprocal(det);
+
+	return affine_slot(FIXED_MULT(matrix->values[4], det),
+					   FIXED_MULT(matrix->values[3], det),
+					   FIXED_MULT(matrix->values[1], det),
+					   FIXED_MULT(matrix->values[0], det));
+}
+
+void draw_affine_big(AffineMatrix matrix, int sprite, int prio, int pal) {
 	int x = FIXED2INT(matrix.values[2]), y = FIXED2INT(matrix.values[5]);
 
 	if (drawing_flags & DFLAG_CAM_FOLLOW) {
@@ -272,6 +610,8 @@ void draw_affine_big(AffineMatrix matrix, int sprite, int prio, int pal) {
 	if (shape == UNLOADED_SPRITE)
 		return;
 
+	sprite_last_drawn[sprite] = game_life;
+
 	x -= shape_width[shape];
 	y -= shape_height[shape];
 
@@ -281,32 +621,14 @@ void draw_affine_big(AffineMatrix matrix, int sprite, int prio, int pal) {
 
 	obj_set_attr(sprite_pointer,
 				 ((shape & 0xC) << 12) | SPRITE_Y(y) | ATTR0_AFF_DBL,
-				 ((shape & 0x3) << 14) | SPRITE_X(x) | ATTR1_AFF_ID(affine_count),
-				 ATTR2_PALBANK(pal) | ATTR2_PRIO(prio) | (sprite_indexes[sprite]));
-
-	int det = FIXED_MULT(matrix.values[0], matrix.values[4]) -
-			  FIXED_MULT(matrix.values[1], matrix.values[3]);
-
-	if (det)
-		det = FIXED_DIV(0x100, det);
-
-	obj_aff_set((obj_aff_buffer + affine_count),
-				FIXED_MULT(matrix.values[4], det),
-				FIXED_MULT(matrix.values[3], det),
-				FIXED_MULT(matrix.values[1], det),
-				FIXED_MULT(matrix.values[0], det));
+				 ((shape & 0x3) << 14) | SPRITE_X(x) | ATTR1_AFF_ID(submit_affine(&matrix)),
+				 ATTR2_PALBANK(pal) | ATTR2_PRIO(prio) | (sprite_indexes[sprite] + sprite_frame_tile[sprite]));
 
 	++sprite_pointer;
 	++sprite_count;
-	++affine_count;
 }
 void draw_affine(AffineMatrix matrix, int sprite, int prio, int pal) {
-	if (affine_count == 32)
-		return;
-
-	AffineMatrix transform = matrix_multiply(matrix_identity(), matrix);
-
-	int x = FIXED2INT(transform.values[2]), y = FIXED2INT(transform.values[5]);
+	int x = FIXED2INT(matrix.values[2]), y = FIXED2INT(matrix.values[5]);
 
 	if (drawing_flags & DFLAG_CAM_FOLLOW) {
 		x -= cam_x - 120;
@@ -318,6 +640,8 @@ void draw_affine(AffineMatrix matrix, int sprite, int prio, int pal) {
 	if (shape == UNLOADED_SPRITE)
 		return;
 
+	sprite_last_drawn[sprite] = game_life;
+
 	x -= shape_width[shape] >> 1;
 	y -= shape_height[shape] >> 1;
 
@@ -327,24 +651,11 @@ void draw_affine(AffineMatrix matrix, int sprite, int prio, int pal) {
 
 	obj_set_attr(sprite_pointer,
 				 ((shape & 0xC) << 12) | SPRITE_Y(y) | ATTR0_AFF,
-				 ((shape & 0x3) << 14) | SPRITE_X(x) | ATTR1_AFF_ID(affine_count),
-				 ATTR2_PALBANK(pal) | ATTR2_PRIO(prio) | (sprite_indexes[sprite]));
-
-	int det = FIXED_MULT(matrix.values[0], matrix.values[4]) -
-			  FIXED_MULT(matrix.values[1], matrix.values[3]);
-
-	if (det)
-		det = FIXED_DIV(0x100, det);
-
-	obj_aff_set((obj_aff_buffer + affine_count),
-				FIXED_MULT(matrix.values[4], det),
-				FIXED_MULT(matrix.values[3], det),
-				FIXED_MULT(matrix.values[1], det),
-				FIXED_MULT(matrix.values[0], det));
+				 ((shape & 0x3) << 14) | SPRITE_X(x) | ATTR1_AFF_ID(submit_affine(&matrix)),
+				 ATTR2_PALBANK(pal) | ATTR2_PRIO(prio) | (sprite_indexes[sprite] + sprite_frame_tile[sprite]));
 
 	++sprite_pointer;
 	++sprite_count;
-	++affine_count;
 }
 void draw(int x, int y, int sprite, int flip, int prio, int pal) {
 	x = FIXED2INT(x);
@@ -360,6 +671,8 @@ void draw(int x, int y, int sprite, int flip, int prio, int pal) {
 	if (shape == UNLOADED_SPRITE)
 		return;
 
+	sprite_last_drawn[sprite] = game_life;
+
 	if (x + shape_width[shape] <= 0 || x > 240 ||
 		y + shape_height[shape] <= 0 || y > 160)
 		return;
@@ -367,7 +680,7 @@ void draw(int x, int y, int sprite, int flip, int prio, int pal) {
 	obj_set_attr(sprite_pointer,
 				 ((shape & 0xC) << 12) | SPRITE_Y(y),
 				 ((shape & 0x3) << 14) | SPRITE_X(x) | flip,
-				 ATTR2_PALBANK(pal) | ATTR2_PRIO(prio) | (sprite_indexes[sprite]));
+				 ATTR2_PALBANK(pal) | ATTR2_PRIO(prio) | (sprite_indexes[sprite] + sprite_frame_tile[sprite]));
 
 	++sprite_pointer;
 	++sprite_count;
@@ -384,6 +697,7 @@ void draw(int x, int y, int sprite, int flip, int prio, int pal) {
 
 int layer_updates;
 int foreground_count;
+unsigned short layer_parallax[4];
 
 #define LAYER_SIZE(n) ((layers[n].gba_meta & 0xC000) >> 14)
 
@@ -422,6 +736,9 @@ void set_layer_size(int layer, int size) {
 	layers[layer].gba_meta = (layers[layer].gba_meta & ~BG_SIZE_MASK) | BG_SIZE(size);
 	layer_updates |= SCREENBLOCK_UPDATED;
 }
+void set_layer_parallax(int layer, int amount) {
+	layer_parallax[layer] = amount;
+}
 void change_layer_type(int layer, int type) {
 
 	if ((LAYER_GET_TYPE(layers[layer]) != LStyle_FG) == (type == LStyle_FG)) {
@@ -494,7 +811,7 @@ void finalize_layers() {
 						BackgroundLayer* bg = (BackgroundLayer*)&layers[i];
 
 						if (bg->tile_meta & TILES_CHANGED) {
-							memcpy(&tile_mem[BG_TILESET][TILESET_OFFSET(bg)], bg->tile_ptr, TILESET_SIZE(bg) << 5);
+							dma_queue_push(&tile_mem[BG_TILESET][TILESET_OFFSET(bg)], bg->tile_ptr, TILESET_SIZE(bg) << 5);
 						}
 						if (bg->tile_meta & MAPPING_CHANGED) {
 							int index = 32 * 32 * size;
@@ -531,14 +848,27 @@ void finalize_layers() {
 
 #pragma endregion
 
+#ifdef PIXTRO_BENCHMARKS
+
+// Make the first `count` banks animate every frame without loading any graphics, the same as animations kept in VRAM.
+// 0 stops them all
+void animate_benchmark_banks(int count) {
+	int i;
+
+	for (i = 0; i < BANK_LIMIT; ++i) {
+		anim_bank[i] = i < count ? (unsigned int*)sprite_frame_tile : NULL;
+		// Shape 0, 4 frames, changing frame every call
+		anim_meta[i] = i < count ? ANIM_RESIDENT | (3 << 12) | (1 << 4) | 1 : 0;
+	}
+}
+
+#endif
+
 void unload_sprites() {
 
 	for (int i = 1; i < BANK_LIMIT; ++i) {
-		sprite_indexes[i] = 0x8000;
-		ordered[i]		  = i;
-		shapes[i]		  = UNLOADED_SPRITE;
-		anim_meta[i]	  = 0;
-		wait_to_load[i]	  = 0;
+		free_sprite_bank(i);
+		anim_meta[i] = 0;
 	}
 }
 
@@ -557,22 +887,26 @@ void init_drawing() {
 	layers[2].gba_meta = BG_PRIO(2);
 	layers[3].gba_meta = BG_PRIO(3);
 
+	layer_parallax[0] = 0x100;
+	layer_parallax[1] = 0x100;
+	layer_parallax[2] = 0x100;
+	layer_parallax[3] = 0x100;
+
 	oam_init(obj_buffer, SPRITE_LIMIT);
 	sprite_pointer = (OBJ_ATTR*)&obj_buffer;
 	int i;
 
-	sprite_indexes[0] = BANK_MEM_START;
-	shapes[0]		  = UNLOADED_SPRITE;
-	for (i = 1; i < BANK_LIMIT; ++i) {
+	reset_obj_tiles();
+
+	for (i = 0; i < BANK_LIMIT; ++i) {
 		sprite_indexes[i] = 0x8000;
-		ordered[i]		  = i;
 		shapes[i]		  = UNLOADED_SPRITE;
 	}
 
 	layer_updates = SCREENBLOCK_UPDATED;
 }
 
-void begin_drawing() {
+HOT_CODE void begin_drawing() {
 	int layerCount = 4; // TODO: Allow for affine layers, meaning this will be less than 4
 
 	is_rendering = 1;
@@ -582,15 +916,6 @@ void begin_drawing() {
 	int i;
 
 	for (i = 0; i < BANK_LIMIT; ++i) {
-		if (wait_to_load[i]) {
-			int* temp = anim_bank[i];
-			load_sprite_at(wait_to_load[i] & 0x0FFFFFFF, i, (wait_to_load[i] >> 28));
-
-			anim_bank[i] = temp;
-
-			wait_to_load[i] = 0;
-		}
-
 		// Don't animate sprites if update paused
 #ifdef __DEBUG__
 		if (ENGINE_DEBUGFLAG(PAUSE_UPDATES))
@@ -618,7 +943,13 @@ void begin_drawing() {
 			int offset		  = (anim_meta[i] & 0xF00) >> 8;
 			int shape		  = (anim_meta[i] & 0xF0000) >> 16;
 
-			load_sprite_at(&anim_bank[i][(offset * (shape2size[shape] >> 2))], i, shape);
+			// Frames already in VRAM only need the tile index moved
+			if (anim_meta[i] & ANIM_RESIDENT) {
+				sprite_frame_tile[i] = offset * (shape2size[shape] >> 5);
+				continue;
+			}
+
+			upload_sprite(&anim_bank[i][(offset * (shape2size[shape] >> 2))], i, shape);
 
 			anim_bank[i] = ptr;
 		}
@@ -637,8 +968,30 @@ void end_drawing() {
 	prev_sprite_count = sprite_count;
 	sprite_count	  = 0;
 	affine_count	  = 0;
+	affine_gen++;
 
-	oam_copy(oam_mem, obj_buffer, SPRITE_LIMIT);
+	oam_ready = 1;
 
 	sprite_pointer = (OBJ_ATTR*)&obj_buffer;
 }
+// Copy the finished sprites into OAM, and set the scroll they were drawn with.  Runs during VBlank so sprites don't
+// change mid frame
+void commit_oam() {
+	if (!oam_ready)
+		return;
+
+	dma3_cpy(oam_mem, obj_buffer, sizeof(obj_buffer));
+
+	unsigned int* scroll = (unsigned int*)bg_scroll;
+
+	BGOFS[0] = scroll[0];
+	BGOFS[1] = scroll[1];
+	BGOFS[2] = scroll[2];
+	BGOFS[3] = scroll[3];
+
+#ifdef SCANLINE_EFFECTS
+	scanline_commit();
+#endif
+
+	oam_ready = 0;
+}
@@ -8,6 +8,7 @@ extern int drawing_flags;
 // Drawing flags
 #define DFLAG_CAM_FOLLOW 0x0001 // Do sprites use cam position data?
 #define DFLAG_CAM_BOUNDS 0x0002 // Keep the camera in the bounds of the level? (ONLY DISABLE IF YOU KNOW WHAT YOU'RE DOING)
+#define DFLAG_COMPACT_SPRITES 0x0004 // Move sprites in VRAM closer together while the screen is faded out
 
 #define SET_DRAWING_FLAG(name)	   drawing_flags |= DFLAG_##name;
 #define CLEAR_DRAWING_FLAG(name)   drawing_flags &= ~DFLAG_##name;
@@ -102,12 +103,21 @@ extern int cam_x, cam_y;
 void set_layer_visible(int layer, bool vis);
 void set_layer_priority(int layer, int prio);
 void set_layer_size(int layer, int size);
+// Scroll speed of a foreground layer compared to the camera, in fixed point.  Defaults to 0x100, the camera's speed
+void set_layer_parallax(int layer, int amount);
 void change_layer_type(int layer, int type);
 
 void load_background(BackgroundLayer* layer, unsigned int* tiles, unsigned int tile_len, unsigned short* mapping, int size);
 
 // ---- Sprites ----
 
+// Max of 128 sprites
+#define SPRITE_LIMIT 128
+// Sprite banks start after the tiles used by particles
+#define BANK_MEM_START 0x60
+
+extern int sprite_count;
+
 // Sprite shapes
 #define SPRITE8x8	0
 #define SPRITE16x16 1
@@ -136,19 +146,31 @@ void load_anim_sprite_at(unsigned int* sprites, int index, int shape, int frames
 void load_obj_pal(unsigned short* pal, int palIndex);
 void load_bg_pal(unsigned short* pal, int palIndex);
 
+// The scroll of each layer as x and y pairs, set by the camera
+extern unsigned short bg_scroll[8];
+
+// Copy the finished sprites and the layers' scroll into the registers.  Runs during VBlank
+void commit_oam();
+
 int get_anim_frame(int anim);
 int get_anim_tick(int anim);
 int get_anim_time(int anim);
 
 // ---- Tilesets ----
-#define LOAD_TILESET(name) load_tileset((unsigned int*)TILESET_##name, (unsigned short*)TILE_MAPPING_##name, (unsigned int*)TILECOLL_##name, TILESET_##name##_len, TILESET_##name##_uvlen)
-void load_tileset(unsigned int* tiles, unsigned short* mapping, unsigned int* collision, int count, int uvcount);
+#define LOAD_TILESET(name) load_tileset((unsigned int*)TILESET_##name, (const unsigned char*)TILESHAPES_##name, TILESET_##name##_len)
+void load_tileset(unsigned int* tiles, const unsigned char* shapes, int count);
 
 void draw(int x, int y, int sprite, int flip, int prio, int pal);
 void draw_affine(AffineMatrix matrix, int sprite, int prio, int pal);
 void draw_affine_big(AffineMatrix matrix, int sprite, int prio, int pal);
 
+void unload_sprite(int index);
 void unload_sprites();
+
+// Sprite VRAM usage, in tiles
+int sprite_tiles_free();
+int sprite_largest_free();
+int compact_sprites();
 void init_drawing();
 void end_drawing();
 
@@ -1,14 +1,39 @@
 #pragma once
+#include "core.h"
 
 extern char level_meta[128];
 
 // ---- Levels ----
 void load_level_pack(unsigned int* level_pack);
 void load_level(int level);
+// Load a level over multiple frames, calling onfinish_async_loading once done.  Entities don't update and the camera
+// doesn't load in tiles while loading, so reset_cam should be called from onfinish_async_loading
+void load_level_async(int level);
 
-extern bool (*physics_code[255])(int x, int y, int width, int height, int vel, bool move_vert);
-extern bool (*collide_code[255])(int x, int y, int width, int height);
+// The max amount of cycles async loading can use each frame
+#ifndef ASYNC_LOAD_BUDGET
+#define ASYNC_LOAD_BUDGET 80000
+#endif
+// Bytes decompressed at a time between checking the budget
+#define ASYNC_LOAD_CHUNK 256
 
-void move_cam();
+// The max amount of levels kept decompressed at once, so going back to one of them only needs to spawn its entities.
+// Levels share 64KB, and the least recently loaded ones are dropped once there's no room left.  Changes made to a
+// cached level's tiles or collision are still there when it's loaded again
+#ifndef LEVEL_CACHE_LIMIT
+#define LEVEL_CACHE_LIMIT 4
+#endif
+// Forget every cached level, so they get decompressed from rom again
+void clear_level_cache();
+
+// Entities that have been unloaded with unload_entity stay gone until the next level pack is loaded.
+// This is kept as one bit per entity in the pack, which can be written to the save file to keep them gone
+int unloaded_entities_size();
+// Write which entities are unloaded into the save file at `index`, taking up unloaded_entities_size() bytes
+void save_unloaded_entities(int index);
+// Read back what save_unloaded_entities wrote.  Needs the same level pack to already be loaded
+void load_unloaded_entities(int index);
+
+HOT_CODE void move_cam();
 void reset_cam();
 int add_entity(int x, int y, int type);
\ No newline at end of file
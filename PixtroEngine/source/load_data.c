@@ -2,10 +2,15 @@
 #include <string.h>
 
 #include "core.h"
+#include "dma_queue.h"
 #include "graphics.h"
+#include "level_data.h"
+#include "levels.h"
 #include "loading.h"
 #include "math.h"
 #include "physics.h"
+#include "profiler.h"
+#include "scanline.h"
 
 #define FIXED2TILE(n) ((n) >> (ACC + 3))
 #define TILE2FIXED(n) ((n) << (ACC + 3))
@@ -13,38 +18,101 @@
 #define INT2TILE(n) ((n) >> 3)
 #define TILE2INT(n) ((n) << 3)
 
-#define VIS_BLOCK_POS(x, y) (((x)&0x1F) + (((y)&0x1F) << 5))
+#define BLOCK2TILE(n) ((n) << (BLOCK_SHIFT - 3))
 
 #define X_TILE_BUFFER (1 * BLOCK_SIZE)
 #define Y_TILE_BUFFER (1 * BLOCK_SIZE)
 
-#define BLOCK_X 30
-#define BLOCK_Y 20
+// Tiles kept loaded around the screen.  The whole screenblock is used, so 32 by 32 tiles
+#define STREAM_TILES 32
+#define STREAM_MASK	 (STREAM_TILES - 1)
 
-#define BGOFS ((vu16*)(REG_BASE + 0x0010))
 
-#define TILE_INFO	   ((unsigned short*)0x02020000)
 #define LEVEL_POINTERS ((unsigned char**)0x0201F000)
 #define LOADED_LEVEL   ((unsigned short*)0x02030000)
+#define CHUNK_TABLE	   ((unsigned char*)0x02020000)
+
+// Levels too big to decompress all at once are split into chunks of 16x16 tiles.  Only chunks near the camera are
+// decompressed, into slots that take the place of the loaded level.  The top bit of the level's width marks these
+#define LEVEL_CHUNKED	0x8000
+#define CHUNK_SHIFT		4
+#define CHUNK_TILES		(1 << CHUNK_SHIFT)
+#define CHUNK_MASK		(CHUNK_TILES - 1)
+#define CHUNK_SIZE		(CHUNK_TILES * CHUNK_TILES)
+#define CHUNK_SLOTS		(0xC000 / (CHUNK_SIZE * 2))
+#define CHUNK_TABLE_LEN 0x2000
+#define NO_SLOT			0xFF
+#define NO_CHUNK		0xFFFF
+
+// Levels are decompressed into the memory from LOADED_LEVEL to the end of EWRAM, which is shared by every cached level
+#define LEVEL_CACHE_POOL ((unsigned char*)LOADED_LEVEL)
+#define LEVEL_CACHE_SIZE 0x10000
 
 // the char array in rom of the current level being loaded
 unsigned char* level_rom;
 // the short array where the level is currently loaded to in ram
 unsigned short* level_ram;
-// the start of the current level
+// the start of the current level.  Each layer is stored as screenblock entries, one after the other
 unsigned short* tileset_data;
-// Array of entities to prevent reloading
-#define unloaded_len 128
-short unloaded_entities[128];
-int unload_index;
+// Where the current level's collision grid is, including the border
+unsigned char* level_collision;
+// The most entities placed in any level pack, worked out by the compiler
+#ifndef LEVEL_ENTITY_BITS
+#define LEVEL_ENTITY_BITS 1024
+#endif
+
+// Entity IDs only have room for this many levels in a pack
+#define PACK_LEVEL_LIMIT ((ENT_ID_LEVEL >> ENT_ID_LEVEL_S) + 1)
+
+// One bit for each entity placed in the level pack, set once it's been unloaded so it doesn't spawn again
+unsigned int unloaded_entities[(LEVEL_ENTITY_BITS + 31) >> 5];
+// The first bit of each level's entities, and the amount of bits the pack uses
+unsigned short level_entity_bit[PACK_LEVEL_LIMIT];
+int pack_entity_bits;
+
+// The bit an entity uses in unloaded_entities, or -1 if it can't fit in the entity's ID
+static inline int entity_bit(int level, int index) {
+	if (level >= PACK_LEVEL_LIMIT || index > (ENT_ID_INDEX >> ENT_ID_INDEX_S))
+		return -1;
+
+	int bit = level_entity_bit[level] + index;
+	return bit < LEVEL_ENTITY_BITS ? bit : -1;
+}
 
 char level_meta[128];
 
 // unsigned short test_values[256];
 
 int level_loading;
+// The next entity to spawn from the level
+int level_entity_index, level_entity_type;
 
 int lvl_width, lvl_height;
+// The size of the level in tiles, and the amount of entries in each layer
+int map_width, map_height, level_layer_size;
+
+// The chunks of the current level, and which chunk each slot is holding
+int level_chunked, chunks_x, chunks_y;
+const unsigned int* chunk_offsets;
+unsigned char* level_start;
+unsigned short slot_chunk[CHUNK_SLOTS], slot_used[CHUNK_SLOTS];
+unsigned short chunk_clock;
+
+// A level that's been decompressed, and can be switched back to without decompressing it again
+typedef struct {
+	short level, layers;
+	unsigned short last_used;
+	unsigned int offset, size;
+	// Where the level's entities are in rom.  NULL until the level has finished decompressing
+	unsigned char* entities;
+} CachedLevel;
+
+CachedLevel level_cache[LEVEL_CACHE_LIMIT];
+unsigned short level_cache_clock;
+
+// Where each foreground layer is scrolled to, and the top left tile loaded into its screenblock
+int layer_scroll_x[4], layer_scroll_y[4];
+int stream_x[4], stream_y[4];
 
 #ifdef __DEBUG__
 int current_level_index;
@@ -52,20 +120,34 @@ int current_level_index;
 
 extern int cam_x, cam_y, prev_cam_x, prev_cam_y;
 
+extern char save_data[SAVEFILE_LEN];
+
 extern int foreground_count;
+extern unsigned short layer_parallax[4];
 
 extern Routine loading_routine;
 
+// State of LZ77 data being decoded over multiple frames
+typedef struct {
+	const unsigned char* src;
+	unsigned char *dst, *end;
+	int flags, flag_count;
+} LZ77Stream;
+
+int add_entity_local(int x, int y, int type, int ent);
+
 void load_level_pack(unsigned int* level_pack) {
 
-	for (int i = 0; i < unloaded_len; i++) {
-		unloaded_entities[i] = -1;
-	}
+	clear_level_cache();
+
+	memset(unloaded_entities, 0, sizeof(unloaded_entities));
+	pack_entity_bits = 0;
 
 	int data		  = level_pack[0];
 	int index		  = 0;
 	int level_loading = 0;
 
+	level_entity_bit[level_loading] = 0;
 	LEVEL_POINTERS[level_loading++] = data;
 	level_pack++;
 
@@ -75,22 +157,15 @@ void load_level_pack(unsigned int* level_pack) {
 		switch (data & 0xF) {
 			case 1: // Set up for next level
 
+				if (level_loading < PACK_LEVEL_LIMIT)
+					level_entity_bit[level_loading] = pack_entity_bits;
 				LEVEL_POINTERS[level_loading++] = (unsigned char*)level_pack[1];
 
 				level_pack++;
 				break;
-			case 4: // Load in tileset collision data
-				{
-					int i;
-
-					level_pack++;
-					for (i = 0; i < level_pack[i] < 0x0FFFFFFF; ++i) {
-						tile_types[i] = level_pack[i];
-						level_pack++;
-					}
-
-					break;
-				}
+			case 2: // Amount of entities placed in the last level
+				pack_entity_bits += data >> 4;
+				break;
 		}
 
 		level_pack++;
@@ -110,13 +185,21 @@ void load_level(int level) {
 	load_level_code();
 }
 
-void load_level_code() {
-
-	lvl_width  = ((short*)level_rom)[0];
-	lvl_height = ((short*)level_rom)[1];
+// Read the level's size and metadata
+void load_level_header() {
+	lvl_width	  = ((unsigned short*)level_rom)[0] & ~LEVEL_CHUNKED;
+	lvl_height	  = ((short*)level_rom)[1];
+	level_chunked = ((unsigned short*)level_rom)[0] & LEVEL_CHUNKED;
+	level_start	  = level_rom;
 
 	level_rom += 4;
 
+	map_width		 = BLOCK2TILE(lvl_width);
+	map_height		 = BLOCK2TILE(lvl_height);
+	level_layer_size = map_width * map_height;
+	chunks_x		 = (map_width + CHUNK_MASK) >> CHUNK_SHIFT;
+	chunks_y		 = (map_height + CHUNK_MASK) >> CHUNK_SHIFT;
+
 	// Clear level metadata
 	int index;
 	for (index = 0; index < 128; ++index) {
@@ -131,111 +214,433 @@ void load_level_code() {
 		level_rom += 2;
 	}
 	level_rom++;
+}
+// ---- Level cache ----
 
-	// Load tilesets
-	short* dst	 = LOADED_LEVEL;
-	tileset_data = LOADED_LEVEL;
+void clear_level_cache() {
+	int i;
+	for (i = 0; i < LEVEL_CACHE_LIMIT; ++i) {
+		level_cache[i].level = -1;
+	}
+}
+// The bytes needed for the current level's visual layers, rounded up to keep the collision grid aligned
+static int level_visual_size() {
+	return ((level_layer_size * foreground_count << 1) + 3) & ~0x3;
+}
+// Find space in the pool for a level, evicting the least recently used levels until there's room
+static CachedLevel* cache_alloc(int size) {
+	int i, j, start;
+
+	if (size > LEVEL_CACHE_SIZE)
+		return NULL;
+
+	for (;;) {
+		CachedLevel *entry = NULL, *oldest = NULL;
+
+		for (i = 0; i < LEVEL_CACHE_LIMIT; ++i) {
+			if (level_cache[i].level < 0)
+				entry = &level_cache[i];
+			else if (!oldest || (unsigned short)(level_cache_clock - level_cache[i].last_used) >
+									(unsigned short)(level_cache_clock - oldest->last_used))
+				oldest = &level_cache[i];
+		}
 
-	for (index = 0; index < foreground_count; ++index) {
+		// Try the start of the pool, then the end of each cached level
+		for (i = -1; entry && i < LEVEL_CACHE_LIMIT; ++i) {
+			if (i >= 0 && level_cache[i].level < 0)
+				continue;
 
-		// Aligning rom pointer to 4 byte interval
-		level_rom += level_rom[0];
+			start = (i < 0) ? 0 : level_cache[i].offset + level_cache[i].size;
 
-		int size = level_rom[0] | (level_rom[1] << 8);
+			if (start + size > LEVEL_CACHE_SIZE)
+				continue;
 
-		level_rom += 2;
+			for (j = 0; j < LEVEL_CACHE_LIMIT; ++j) {
+				if (level_cache[j].level >= 0 && start < level_cache[j].offset + level_cache[j].size &&
+					level_cache[j].offset < start + size)
+					break;
+			}
+
+			if (j == LEVEL_CACHE_LIMIT) {
+				entry->offset = start;
+				entry->size	  = size;
+				return entry;
+			}
+		}
+
+		oldest->level = -1;
+	}
+}
+// Get the current level from the cache, if it's been fully decompressed before
+static CachedLevel* find_cached_level() {
+	int i;
 
-		LZ77UnCompWram(level_rom, dst);
+	if (level_chunked)
+		return NULL;
 
-		level_rom += size;
+	for (i = 0; i < LEVEL_CACHE_LIMIT; ++i) {
+		CachedLevel* cached = &level_cache[i];
 
-		dst += 0x2000;
+		if (cached->level == level_loading && cached->layers == foreground_count && cached->entities)
+			return cached;
 	}
 
-	// unload entities
+	return NULL;
+}
+// Switch to a cached level.  Only the entities are left to load
+static void use_cached_level(CachedLevel* cached) {
+	cached->last_used = ++level_cache_clock;
+
+	tileset_data	= (unsigned short*)(LEVEL_CACHE_POOL + cached->offset);
+	level_collision = (unsigned char*)tileset_data + level_visual_size();
+	level_rom		= cached->entities;
+
+	reset_collision_grid(level_collision);
+}
+// Pick where the current level gets decompressed to.  Returns its cache entry, or NULL if it can't be cached
+static CachedLevel* place_level() {
+	CachedLevel* cached = NULL;
+
+	if (!level_chunked)
+		cached = cache_alloc(level_visual_size() + (((lvl_width + 2) * (lvl_height + 2) + 3) & ~0x3));
+
+	if (cached) {
+		cached->level	  = level_loading;
+		cached->layers	  = foreground_count;
+		cached->entities  = NULL;
+		cached->last_used = ++level_cache_clock;
+
+		tileset_data	= (unsigned short*)(LEVEL_CACHE_POOL + cached->offset);
+		level_collision = (unsigned char*)tileset_data + level_visual_size();
+	} else {
+		// Chunked levels, and levels too big to share the pool, use all of it
+		clear_level_cache();
+
+		tileset_data	= LOADED_LEVEL;
+		level_collision = COLLISION_GRID;
+	}
+
+	reset_collision_grid(level_collision);
+	return cached;
+}
+
+// Returns the compressed data of the next foreground layer, and moves level_rom past it
+unsigned char* next_level_layer() {
+	// Aligning rom pointer to 4 byte interval
+	level_rom += level_rom[0];
+
+	int size = level_rom[0] | (level_rom[1] << 8);
+
+	level_rom += 2;
+
+	unsigned char* data = level_rom;
+
+	level_rom += size;
 
-	index		 = 0;
+	return data;
+}
+// Empty every chunk slot, and get ready to load chunks using the level's table of chunk offsets
+void reset_chunks(const unsigned char* table) {
+	int count = chunks_x * chunks_y * foreground_count;
+
+	chunk_offsets = (const unsigned int*)table;
+
+	memset(CHUNK_TABLE, NO_SLOT, count < CHUNK_TABLE_LEN ? count : CHUNK_TABLE_LEN);
+	memset(slot_chunk, 0xFF, sizeof(slot_chunk));
+	memset(slot_used, 0, sizeof(slot_used));
+	chunk_clock = 0;
+}
+// Get a chunk of one of the level's layers, decompressing it over the least recently used chunk if it isn't loaded
+HOT_CODE unsigned short* get_chunk(int layer, int x, int y) {
+	int chunk = ((layer * chunks_y) + y) * chunks_x + x;
+	int slot  = CHUNK_TABLE[chunk];
+
+	if (slot == NO_SLOT) {
+		int i;
+
+		slot = 0;
+		for (i = 0; i < CHUNK_SLOTS; ++i) {
+			if (slot_chunk[i] == NO_CHUNK) {
+				slot = i;
+				break;
+			}
+			if ((unsigned short)(chunk_clock - slot_used[i]) > (unsigned short)(chunk_clock - slot_used[slot]))
+				slot = i;
+		}
+
+		if (slot_chunk[slot] != NO_CHUNK)
+			CHUNK_TABLE[slot_chunk[slot]] = NO_SLOT;
+
+		LZ77UnCompWram(level_start + chunk_offsets[chunk], LOADED_LEVEL + (slot * CHUNK_SIZE));
+
+		CHUNK_TABLE[chunk] = slot;
+		slot_chunk[slot]   = chunk;
+	}
+
+	slot_used[slot] = chunk_clock;
+	return LOADED_LEVEL + (slot * CHUNK_SIZE);
+}
+// Unload every entity that isn't persistent, and get ready to spawn the level's entities
+void unload_level_entities() {
+	int index	 = 0;
 	max_entities = 0;
 	for (; index < ENTITY_LIMIT; ++index) {
-		if (ENT_FLAG(PERSISTENT, index)) {
-			if (max_entities != index)
-				entities[max_entities] = entities[index];
+		if (ENT_FLAG(LOADED, index) && ENT_FLAG(PERSISTENT, index)) {
+			if (max_entities != index) {
+				move_entity(max_entities, index);
+				ENT_ID(index) = 0;
+			}
 
 			++max_entities;
 		} else {
-			entities[index].flags[0] = 0;
-			entities[index].flags[1] = 0;
-			entities[index].flags[2] = 0;
-			entities[index].flags[3] = 0;
-			entities[index].flags[4] = 0;
+			ENT_ID(index)	   = 0;
+			ENT_DATA(index, 0) = 0;
+			ENT_DATA(index, 1) = 0;
+			ENT_DATA(index, 2) = 0;
+			ENT_DATA(index, 3) = 0;
+			ENT_DATA(index, 4) = 0;
 		}
 	}
 
-	// int val = tileset_data;
+	// Persistent entities have been moved, so rebuild the entity lists
+	reset_entity_lists();
+
+	level_entity_index = 0;
+	level_entity_type  = *level_rom;
+	level_rom++;
+}
+// Spawn the next entity in the level.  Returns 0 once there are none left to spawn
+int load_next_entity() {
+	if (level_entity_type == 0xFF || !free_entities.count)
+		return 0;
+
+	int x = level_rom[0],
+		y = level_rom[1];
+	level_rom += 2;
 
-	// val += lvl_width * lvl_height * 2 * foreground_count;
-	// val = (val + 3) & ~0x3;
+	int bit = entity_bit(level_loading, level_entity_index);
 
-	// level_rom = *((unsigned int**)((unsigned int*)val));
+	if (bit < 0 || !(unloaded_entities[bit >> 5] & (1 << (bit & 0x1F)))) {
+		int slot	   = alloc_entity();
+		int is_loading = add_entity_local(x, y, level_entity_type, slot);
 
-	// load entities
-	int type;
-	type = *level_rom;
+		if (is_loading) {
+			if (bit >= 0)
+				ENT_ID(slot) |= (level_loading << ENT_ID_LEVEL_S) | (level_entity_index << ENT_ID_INDEX_S);
+
+			if (max_entities <= slot)
+				max_entities = slot + 1;
+		} else {
+			remove_entity(slot);
+		}
+	}
+
+	while (*level_rom++ != 0xFF)
+		;
+
+	level_entity_type = level_rom[0];
+
+	level_entity_index++;
 	level_rom++;
 
-	index = 0;
+	return 1;
+}
 
-	while (type != 0xFF && max_entities < ENTITY_LIMIT) {
-		int x = level_rom[0],
-			y = level_rom[1];
-		level_rom += 2;
+void load_level_code() {
 
-		int ent_idx = (level_loading) | (index << 6);
+	load_level_header();
 
-		for (int i = 0; unloaded_entities[i] != -1; i++) {
-			if (unloaded_entities[i] == ent_idx) {
-				ent_idx = -1;
-				break;
+	CachedLevel* cached = find_cached_level();
+
+	if (cached) {
+		use_cached_level(cached);
+	} else {
+		cached = place_level();
+
+		// Collision grid comes first, before the visual layers
+		LZ77UnCompWram(next_level_layer(), level_collision);
+
+		if (level_chunked) {
+			// Chunks get loaded by the camera once they're needed
+			reset_chunks(next_level_layer());
+		} else {
+			// Load tilesets
+			unsigned short* dst = tileset_data;
+
+			int index;
+			for (index = 0; index < foreground_count; ++index) {
+				LZ77UnCompWram(next_level_layer(), dst);
+
+				dst += level_layer_size;
 			}
 		}
 
-		if (ent_idx >= 0) {
-			ent_idx <<= 5;
-			int is_loading = add_entity_local(x, y, type, max_entities);
+		if (cached)
+			cached->entities = level_rom;
+	}
+
+	// unload entities
+	unload_level_entities();
+
+	// load entities
+	while (load_next_entity())
+		;
+
+	level_rom = NULL;
+}
+
+// ---- Async loading ----
+
+// Start decoding LZ77 data (in the same format the BIOS uses)
+void lz77_start(LZ77Stream* stream, const unsigned char* src, void* dst) {
+	int size = src[1] | (src[2] << 8) | (src[3] << 16);
+
+	stream->src		   = src + 4;
+	stream->dst		   = dst;
+	stream->end		   = stream->dst + size;
+	stream->flag_count = 0;
+}
+// Decode at least `len` bytes, stopping early if the data is finished.  Returns 1 once finished
+int lz77_decode(LZ77Stream* stream, int len) {
+	const unsigned char* src = stream->src;
+	unsigned char* dst		 = stream->dst;
+	unsigned char* stop		 = dst + len;
+
+	if (stop > stream->end)
+		stop = stream->end;
+
+	while (dst < stop) {
+		if (!stream->flag_count) {
+			stream->flags	   = *src++;
+			stream->flag_count = 8;
+		}
+
+		stream->flag_count--;
+
+		if (stream->flags & 0x80) {
+			// Copy from data already decoded
+			int count = (src[0] >> 4) + 3;
+			unsigned char* from = dst - (((src[0] & 0xF) << 8) | src[1]) - 1;
+			src += 2;
+
+			while (count--)
+				*dst++ = *from++;
+		} else {
+			*dst++ = *src++;
+		}
+
+		stream->flags <<= 1;
+	}
+
+	stream->src = src;
+	stream->dst = dst;
+
+	return dst >= stream->end;
+}
+
+LZ77Stream async_stream;
+int async_layer;
+CachedLevel* async_level;
+
+void load_level_async(int level) {
+#ifdef __DEBUG__
+	current_level_index = level;
+#endif
+
+	level_loading = level;
+	level_rom	  = LEVEL_POINTERS[level];
+
+	reset_routine(loading_routine);
+	SET_ENGINE_FLAG(LOADING_ASYNC);
+}
+
+void async_loading() {
+	unsigned int start = cycle_count();
+
+#define ASYNC_OUT_OF_TIME (cycle_count() - start > ASYNC_LOAD_BUDGET)
+
+	rt_begin(loading_routine);
+	{
+		load_level_header();
 
-			if (is_loading) {
-				entities[max_entities].ID |= ent_idx;
-				++max_entities;
+		async_level = find_cached_level();
+
+		if (async_level) {
+			use_cached_level(async_level);
+			async_layer = foreground_count;
+		} else {
+			async_level = place_level();
+
+			// Layer -1 is the collision grid, which comes before the visual layers
+			async_layer = -1;
+			lz77_start(&async_stream, next_level_layer(), level_collision);
+		}
+	}
+	rt_step();
+	{
+		// Decompress the layers a chunk at a time, continuing next frame when out of time
+		while (async_layer < foreground_count) {
+			if (lz77_decode(&async_stream, ASYNC_LOAD_CHUNK)) {
+				// Chunked levels only have the chunk table after the collision grid
+				if (level_chunked) {
+					reset_chunks(next_level_layer());
+					async_layer = foreground_count;
+				} else if (++async_layer < foreground_count)
+					lz77_start(&async_stream, next_level_layer(), tileset_data + (async_layer * level_layer_size));
 			}
+
+			if (ASYNC_OUT_OF_TIME)
+				rt_repeat();
 		}
 
-		while (*level_rom++ != 0xFF)
-			;
+		if (async_level)
+			async_level->entities = level_rom;
 
-		type = level_rom[0];
+		unload_level_entities();
+	}
+	rt_step();
+	{
+		// Spawn entities until they've all been loaded, or until out of time
+		while (load_next_entity()) {
+			if (ASYNC_OUT_OF_TIME)
+				rt_repeat();
+		}
 
-		index++;
-		level_rom++;
+		level_rom = NULL;
+
+		REMOVE_ENGINE_FLAG(LOADING_ASYNC);
+
+		if (onfinish_async_loading)
+			onfinish_async_loading();
 	}
+	rt_end();
 
-	level_rom = NULL;
+#undef ASYNC_OUT_OF_TIME
 }
 
 int add_entity_local(int x, int y, int type, int ent) {
-	entities[ent].vel_x = 0;
-	entities[ent].vel_y = 0;
+	ENT_VEL_X(ent) = 0;
+	ENT_VEL_Y(ent) = 0;
 
-	entities[ent].x	 = BLOCK2FIXED(x);
-	entities[ent].y	 = BLOCK2FIXED(y);
-	entities[ent].ID = type;
-	entities[ent].ID |= ENT_LOADED_FLAG | ENT_VISIBLE_FLAG | ENT_ACTIVE_FLAG;
+	ENT_X(ent)	= BLOCK2FIXED(x);
+	ENT_Y(ent)	= BLOCK2FIXED(y);
+	ENT_ID(ent) = type;
+	ENT_ID(ent) |= ENT_LOADED_FLAG | ENT_VISIBLE_FLAG | ENT_ACTIVE_FLAG;
+	ENT_LAYERS(ent)	  = ENT_LAYER_DEFAULT;
+	ENT_HIT_MASK(ent) = ENT_HIT_DEFAULT;
 
 	int is_loading = 1;
 
+	refresh_entity(ent);
+	schedule_entity(ent);
+
 	if (entity_inits[type])
 		entity_inits[type](ent, level_rom, &is_loading);
 	else
-		entities[ent].ID &= ~ENT_LOADED_FLAG | ENT_ACTIVE_FLAG;
+		ENT_ID(ent) &= ~ENT_LOADED_FLAG | ENT_ACTIVE_FLAG;
+
+	// The init function may have changed the entity's flags
+	refresh_entity(ent);
 
 	return is_loading;
 }
@@ -246,31 +651,44 @@ int add_entity(int x, int y, int type) {
 	unsigned char* ptr = level_rom;
 	level_rom		   = NULL;
 
-	int index = 0;
-	while (index < ENTITY_LIMIT) {
-		if (!ENT_FLAG(LOADED, index)) {
-			retval = index;
-			add_entity_local(x, y, type, index);
+	int index = alloc_entity();
 
-			if (max_entities <= index)
-				max_entities = index + 1;
-			break;
-		}
+	if (index >= 0) {
+		retval = index;
+		add_entity_local(x, y, type, index);
+
+		if (max_entities <= index)
+			max_entities = index + 1;
 	}
 
 	level_rom = ptr;
 	return retval;
 }
 
+#ifndef ENTITY_SOA
 void unload_entity(Entity* ent) {
-	int idx = (ent->ID & (ENT_ID_LEVEL | ENT_ID_INDEX)) >> 5;
+	unload_entity_at(ent - entities);
+}
+#endif
+void unload_entity_at(unsigned int index) {
+	int bit = entity_bit((ENT_ID(index) & ENT_ID_LEVEL) >> ENT_ID_LEVEL_S, (ENT_ID(index) & ENT_ID_INDEX) >> ENT_ID_INDEX_S);
 
-	for (int i = 0; i < unloaded_len; i++) {
-		if (unloaded_entities[i] == -1) {
-			unloaded_entities[i] = idx;
-			break;
-		}
-	}
+	if (bit >= 0)
+		unloaded_entities[bit >> 5] |= 1 << (bit & 0x1F);
+}
+
+int unloaded_entities_size() {
+	return (SIGNED_MIN(pack_entity_bits, LEVEL_ENTITY_BITS) + 7) >> 3;
+}
+void save_unloaded_entities(int index) {
+	int size = unloaded_entities_size();
+
+	memcpy(&save_data[index], unloaded_entities, size);
+	mark_file_dirty(index, size);
+}
+void load_unloaded_entities(int index) {
+	memset(unloaded_entities, 0, sizeof(unloaded_entities));
+	memcpy(unloaded_entities, &save_data[index], unloaded_entities_size());
 }
 
 void protect_cam() {
@@ -285,237 +703,198 @@ void protect_cam() {
 	if (cam_y + 160 + Y_TILE_BUFFER > BLOCK2INT(lvl_height))
 		cam_y = BLOCK2INT(lvl_height) - 160 - Y_TILE_BUFFER;
 
-	int l;
+	int l, x, y;
 	for (l = 0; l < 4; ++l) {
 		if (LAYER_GET_TYPE(layers[l]) == LStyle_FG) {
 
-			BGOFS[(l << 1) + 0] = cam_x;
-			BGOFS[(l << 1) + 1] = cam_y;
+			x = FIXED_MULT(cam_x, layer_parallax[l]);
+			y = FIXED_MULT(cam_y, layer_parallax[l]);
+
+			// Layers scrolling faster than the camera still have to stay inside the level
+			if (x > TILE2INT(map_width) - 240)
+				x = TILE2INT(map_width) - 240;
+			if (y > TILE2INT(map_height) - 160)
+				y = TILE2INT(map_height) - 160;
+			if (x < 0)
+				x = 0;
+			if (y < 0)
+				y = 0;
+
+			layer_scroll_x[l] = x;
+			layer_scroll_y[l] = y;
 
 		} else {
-			BGOFS[(l << 1) + 0] = FIXED_MULT(cam_x, 0x80);
-			BGOFS[(l << 1) + 1] = FIXED_MULT(cam_y, 0x80);
+			x = FIXED_MULT(cam_x, 0x80);
+			y = FIXED_MULT(cam_y, 0x80);
 		}
+
+		// Written to the background registers when the frame's sprites are, so they both move at once
+		bg_scroll[(l << 1) + 0] = x;
+		bg_scroll[(l << 1) + 1] = y;
+
+#ifdef SCANLINE_EFFECTS
+		scanline_scroll(l, x, y);
+#endif
 	}
 }
-#ifdef LARGE_TILES
-void copy_tiles(unsigned short* screen, unsigned short* data, int x, int y, int len) {
-	int i;
 
-	if (x & 0x1) {
-		int vis = data[0];
-		if (vis != 0) {
-			vis--;
+// Copy part of a row of one of the level's layers into a screenblock, wrapping around the screenblock's edge
+HOT_CODE static void stream_row(unsigned short* screen, int layer, int x, int y, int len) {
+	// Tiles outside the level are never on screen
+	if (y < 0 || y >= map_height)
+		return;
+	if (x < 0) {
+		len += x;
+		x = 0;
+	}
+	if (x + len > map_width)
+		len = map_width - x;
 
-			int tile = TILE_INFO[((vis & 0xFF) << 2) | ((y ^ (vis >> 11)) & 0x1) | (((~vis >> 10) & 0x1) << 1)];
+	const unsigned short* src;
+	int run;
 
-			tile ^= vis & 0x0C00; // Flip Index
-			tile += vis & 0xF000; // Palette
-			screen[0] = tile;
-		}
+	screen += (y & STREAM_MASK) << 5;
 
-		len--;
-		screen++;
-		data++;
-	}
+	// Chunks are smaller than the screenblock, so splitting at chunks also splits at the screenblock's edge
+	while (len > 0) {
+		if (level_chunked) {
+			src = get_chunk(layer, x >> CHUNK_SHIFT, y >> CHUNK_SHIFT) + (x & CHUNK_MASK) + ((y & CHUNK_MASK) << CHUNK_SHIFT);
+			run = CHUNK_TILES - (x & CHUNK_MASK);
+		} else {
+			src = tileset_data + (layer * level_layer_size) + x + (y * map_width);
+			run = STREAM_TILES - (x & STREAM_MASK);
+		}
 
-	int testIndex = 0;
+		if (run > len)
+			run = len;
 
-	for (i = (len & ~0x1) - 2; i >= 0; i -= 2) {
-		int vis = data[i >> 1];
-		if (vis == 0)
-			continue;
-		vis--;
+		dma3_copy_now(&screen[x & STREAM_MASK], src, run, DMA_CPY16);
 
-		int tile = TILE_INFO[((vis & 0xFF) << 2) | ((y ^ (vis >> 11)) & 0x1) | (((vis >> 10) & 0x1) << 1)];
+		x += run;
+		len -= run;
+	}
+}
+// Copy part of a column of one of the level's layers into a screenblock.  Neither the level or the screenblock have
+// columns next to each other in memory, so this is done one tile at a time
+HOT_CODE static void stream_column(unsigned short* screen, int layer, int x, int y, int len) {
+	if (x < 0 || x >= map_width)
+		return;
+	if (y < 0) {
+		len += y;
+		y = 0;
+	}
+	if (y + len > map_height)
+		len = map_height - y;
 
-		tile ^= vis & 0x0C00; // Flip Index
-		tile += vis & 0xF000; // Palette
+	const unsigned short* src;
+	int run, step;
 
-		screen[i] = tile;
+	screen += x & STREAM_MASK;
 
-		tile = TILE_INFO[((vis & 0xFF) << 2) | ((y ^ (vis >> 11)) & 0x1) | (((~vis >> 10) & 0x1) << 1)];
+	while (len > 0) {
+		if (level_chunked) {
+			src	 = get_chunk(layer, x >> CHUNK_SHIFT, y >> CHUNK_SHIFT) + (x & CHUNK_MASK) + ((y & CHUNK_MASK) << CHUNK_SHIFT);
+			step = CHUNK_TILES;
+			run	 = CHUNK_TILES - (y & CHUNK_MASK);
+		} else {
+			src	 = tileset_data + (layer * level_layer_size) + x + (y * map_width);
+			step = map_width;
+			run	 = len;
+		}
 
-		tile ^= vis & 0x0C00; // Flip Index
-		tile += vis & 0xF000; // Palette
-		screen[i + 1] = tile;
-	}
+		if (run > len)
+			run = len;
 
-	if (len & 0x1) {
-		int vis = data[len >> 1];
-		if (vis != 0) {
-			vis--;
+		len -= run;
 
-			int tile = TILE_INFO[((vis & 0xFF) << 2) | ((y ^ (vis >> 11)) & 0x1) | (((vis >> 10) & 0x1) << 1)];
+		for (; run > 0; --run) {
+			screen[(y & STREAM_MASK) << 5] = *src;
 
-			tile ^= vis & 0x0C00; // Flip Index
-			tile += vis & 0xF000; // Palette
-			screen[len - 1] = tile;
+			src += step;
+			++y;
 		}
 	}
 }
-void move_cam() {
-	cam_x -= 120;
-	cam_y -= 80;
+// Load every tile around a foreground layer's scroll position
+static void stream_screen(int l, unsigned short* screen, int layer) {
+	int y;
 
-	protect_cam();
-
-	if (foreground_count == 0)
-		goto skip_loadcam;
+	stream_x[l] = INT2TILE(layer_scroll_x[l]);
+	stream_y[l] = INT2TILE(layer_scroll_y[l]);
 
-	int moveX = INT2TILE(cam_x) - INT2TILE(prev_cam_x),
-		moveY = INT2TILE(cam_y) - INT2TILE(prev_cam_y);
+	for (y = 0; y < STREAM_TILES; ++y)
+		stream_row(screen, layer, stream_x[l], stream_y[l] + y, STREAM_TILES);
+}
 
-	if (!moveX && !moveY)
-		goto skip_loadcam;
+// The first row or column of tiles to keep loaded.  Every tile at the new scroll has to be loaded, and the tiles at the
+// shown scroll are kept too when they fit.  Only about a tile of sideways scroll fits in a frame, so anything faster
+// replaces the tiles on the edge the screen is moving away from a frame early
+static inline int stream_start(int shown, int scroll, int screen_size) {
+	int start = INT2TILE(SIGNED_MIN(shown, scroll)), last = INT2TILE(scroll + screen_size - 1);
 
-	int xMin = INT2TILE(SIGNED_MIN(prev_cam_x, cam_x)) - 1;
-	int xMax = INT2TILE(SIGNED_MAX(prev_cam_x, cam_x)) + BLOCK_X + 1;
-	int yMin = INT2TILE(SIGNED_MIN(prev_cam_y, cam_y)) - 1;
-	int yMax = INT2TILE(SIGNED_MAX(prev_cam_y, cam_y)) + BLOCK_Y + 1;
-
-	unsigned short* foreground = se_mem[31];
-	unsigned short* midground  = se_mem[30];
-	unsigned short* background = se_mem[29];
-
-	if (foreground_count <= 2)
-		background = NULL;
-	if (foreground_count <= 1)
-		midground = NULL;
-
-	int position;
-
-	// Get the start X and Y rows needed to edit, and the direction each is needed to move.
-	// Get the end destinations for x and y.
-
-	int dirX = INT_SIGN(moveX), dirY = INT_SIGN(moveY);
-	int startX = (dirX < 0) ? xMin : xMax, startY = (dirY < 0) ? yMin : yMax;
-	int endX = startX + moveX, endY = startY + moveY;
-	int min, max;
-
-	if (startX != endX)
-		startX -= dirX;
-	if (startY != endY)
-		startY -= dirY;
-
-	if (dirX == 0)
-		dirX = 1;
-	if (dirY == 0)
-		dirY = 1;
-
-	do {
-
-		if (startX != endX) {
-			min = startY - (BLOCK_Y + 2) * dirY;
-			max = startY;
-
-			for (; min != max; min += dirY) {
-				position = VIS_BLOCK_POS(startX, min);
-
-				int vis = tileset_data[(startX >> 1) + ((min >> 1) * lvl_width)];
-
-				int tile = TILE_INFO[((vis & 0xFF) << 2) | ((min ^ (vis >> 11)) & 0x1) | (((startX ^ (vis >> 10)) & 0x1) << 1)];
-				tile ^= vis & 0x0C00;
-				tile += vis & 0xF000;
-				foreground[position] = tile;
-
-				if (midground) {
-					tile = TILE_INFO[((vis & 0xFF) << 2) | ((min ^ (vis >> 11)) & 0x1) | (((startX ^ (vis >> 10)) & 0x1) << 1)];
-					tile ^= vis & 0x0C00;
-					tile += vis & 0xF000;
-					midground[position] = tile;
-				}
-				if (background) {
-					tile = TILE_INFO[((vis & 0xFF) << 2) | ((min ^ (vis >> 11)) & 0x1) | (((startX ^ (vis >> 10)) & 0x1) << 1)];
-					tile ^= vis & 0x0C00;
-					tile += vis & 0xF000;
-					background[position] = tile;
-				}
-			}
-			startX += dirX;
-		}
+	if (start < last - STREAM_MASK)
+		start = last - STREAM_MASK;
 
-		if (startY != endY) {
-
-			min = startX - (BLOCK_X + 2) * dirX;
-			max = startX;
-
-			for (; min != max; min += dirX) {
-				position = VIS_BLOCK_POS(min, startY);
-
-				int vis = tileset_data[(min >> 1) + ((startY >> 1) * lvl_width)];
-
-				int tile = TILE_INFO[((vis & 0xFF) << 2) | ((startY ^ (vis >> 11)) & 0x1) | (((min ^ (vis >> 10)) & 0x1) << 1)];
-				tile ^= vis & 0x0C00;
-				tile += vis & 0xF000;
-				foreground[position] = tile;
-
-				if (midground) {
-					tile = TILE_INFO[((vis & 0xFF) << 2) | ((startY ^ (vis >> 11)) & 0x1) | (((min ^ (vis >> 10)) & 0x1) << 1)];
-					tile ^= vis & 0x0C00;
-					tile += vis & 0xF000;
-					midground[position] = tile;
-				}
-				if (background) {
-					tile = TILE_INFO[((vis & 0xFF) << 2) | ((startY ^ (vis >> 11)) & 0x1) | (((min ^ (vis >> 10)) & 0x1) << 1)];
-					tile ^= vis & 0x0C00;
-					tile += vis & 0xF000;
-					background[position] = tile;
-				}
-			}
-			startY += dirY;
-		}
-	} while (startX != endX || startY != endY);
+	return start;
+}
 
-skip_loadcam:
+HOT_CODE void move_cam() {
+	// The scroll on screen until the next VBlank
+	int shown_x[4], shown_y[4];
 
-	prev_cam_x = cam_x;
-	prev_cam_y = cam_y;
+	memcpy(shown_x, layer_scroll_x, sizeof(shown_x));
+	memcpy(shown_y, layer_scroll_y, sizeof(shown_y));
 
-	cam_x += 120;
-	cam_y += 80;
-}
-void reset_cam() {
-	// Get top left position
 	cam_x -= 120;
 	cam_y -= 80;
 
 	protect_cam();
 
-	// If there are no layers to set, don't change anything
-	if (foreground_count == 0)
+	// If there are no layers to set, or the level is still being loaded in, don't change anything
+	if (foreground_count == 0 || ENGINE_HAS_FLAG(LOADING_ASYNC))
 		goto skip_loadcam;
 
-	int val;
-
-	int x = INT2TILE(cam_x);
-	int y = INT2TILE(cam_y);
-
-	// x &= ~0x1;
-
-	unsigned short* foreground = se_mem[31];
-	unsigned short* midground  = se_mem[30];
-	unsigned short* background = se_mem[29];
+	// Each foreground layer shows the next layer of the level
+	int l, x, y, layer = 0;
 
-	if (foreground_count < 3)
-		background = 0;
-	if (foreground_count < 2)
-		midground = 0;
+	chunk_clock++;
 
-	val = 22;
-	while (val-- > 0) {
+	for (l = 0; l < 4; ++l) {
+		if (LAYER_GET_TYPE(layers[l]) != LStyle_FG)
+			continue;
 
-		int p1 = VIS_BLOCK_POS(x, y);
-		int p2 = ((y >> 1) * lvl_width) + (x >> 1);
+		unsigned short* screen = se_mem[(layers[l].gba_meta & 0x1F00) >> 8];
 
-		copy_tiles(&foreground[p1], &tileset_data[p2], x, y, 32 - x);
+		// Tiles are copied straight away, but the new scroll only shows after the next VBlank.  Keeping the tiles
+		// for both scrolls loaded means the screen doesn't show a tile that's been replaced early
+		x = stream_start(shown_x[l], layer_scroll_x[l], 240);
+		y = stream_start(shown_y[l], layer_scroll_y[l], 160);
 
-		p1 &= 0xFE0;
-		p2 += (32 - x) >> 1;
+		// Moved too far for any of the loaded tiles to still be used
+		if (INT_ABS(x - stream_x[l]) >= STREAM_TILES || INT_ABS(y - stream_y[l]) >= STREAM_TILES) {
+			stream_screen(l, screen, layer++);
+			continue;
+		}
 
-		copy_tiles(&foreground[p1], &tileset_data[p2], 0, y, x);
+		// Columns are loaded for the rows already there, then rows are loaded for the new columns
+		while (stream_x[l] < x) {
+			stream_column(screen, layer, stream_x[l] + STREAM_TILES, stream_y[l], STREAM_TILES);
+			stream_x[l]++;
+		}
+		while (stream_x[l] > x) {
+			stream_x[l]--;
+			stream_column(screen, layer, stream_x[l], stream_y[l], STREAM_TILES);
+		}
+		while (stream_y[l] < y) {
+			stream_row(screen, layer, stream_x[l], stream_y[l] + STREAM_TILES, STREAM_TILES);
+			stream_y[l]++;
+		}
+		while (stream_y[l] > y) {
+			stream_y[l]--;
+			stream_row(screen, layer, stream_x[l], stream_y[l], STREAM_TILES);
+		}
 
-		++y;
+		layer++;
 	}
 
 skip_loadcam:
@@ -526,96 +905,27 @@ skip_loadcam:
 	cam_x += 120;
 	cam_y += 80;
 }
-#else
-void move_cam() {
+void reset_cam() {
+	// Get top left position
 	cam_x -= 120;
 	cam_y -= 80;
 
 	protect_cam();
 
+	// If there are no layers to set, don't change anything
 	if (foreground_count == 0)
 		goto skip_loadcam;
 
-	unsigned short* grounds[3] = {NULL, NULL, NULL};
-
-	int j = 0;
-
-	for (int i = 0; i < 4; ++i) {
-		if (LAYER_GET_TYPE(layers[i]) == LStyle_FG) {
-			grounds[j++] = &se_mem[(layers[i].gba_meta & 0x1F00) >> 8];
-		}
-	}
-
-	int moveX = INT2BLOCK(cam_x) - INT2BLOCK(prev_cam_x),
-		moveY = INT2BLOCK(cam_y) - INT2BLOCK(prev_cam_y);
-
-	if (!moveX && !moveY)
-		goto skip_loadcam;
-
-	int xMin = INT2BLOCK(SIGNED_MIN(prev_cam_x, cam_x)) - 1;
-	int xMax = INT2BLOCK(SIGNED_MAX(prev_cam_x, cam_x)) + BLOCK_X + 1;
-	int yMin = INT2BLOCK(SIGNED_MIN(prev_cam_y, cam_y)) - 1;
-	int yMax = INT2BLOCK(SIGNED_MAX(prev_cam_y, cam_y)) + BLOCK_Y + 1;
-
-	int position;
+	int l, layer = 0;
 
-	// Get the start X and Y rows needed to edit, and the direction each is needed to move.
-	// Get the end destinations for x and y.
+	chunk_clock++;
 
-	int dirX = INT_SIGN(moveX), dirY = INT_SIGN(moveY);
-	int startX = (dirX < 0) ? xMin : xMax, startY = (dirY < 0) ? yMin : yMax;
-	int endX = startX + moveX, endY = startY + moveY;
-	int min, max;
-
-	if (startX != endX)
-		startX -= dirX;
-	if (startY != endY)
-		startY -= dirY;
-
-	if (dirX == 0)
-		dirX = 1;
-	if (dirY == 0)
-		dirY = 1;
-
-	do {
-
-		if (startX != endX) {
-			min = startY - (BLOCK_Y + 2) * dirY;
-			max = startY;
-
-			for (; min != max; min += dirY) {
-				position = VIS_BLOCK_POS(startX, min);
-
-				short* ptr = &tileset_data[startX + (min * lvl_width)];
-
-				grounds[0][position] = TILE_INFO[*ptr & 0xFFF] | (*ptr & 0xF000);
-				if (grounds[1])
-					grounds[1][position] = TILE_INFO[ptr[0x2000] & 0xFFF] | (ptr[0x2000] & 0xF000);
-				// if (background)
-				// 	background[position] = tileset_data[startX + (min * lvl_width) + 0x4000];
-			}
-			startX += dirX;
-		}
-
-		if (startY != endY) {
-
-			min = startX - (BLOCK_X + 2) * dirX;
-			max = startX;
-
-			for (; min != max; min += dirX) {
-				position = VIS_BLOCK_POS(min, startY);
-
-				short* ptr = &tileset_data[min + (startY * lvl_width)];
+	for (l = 0; l < 4; ++l) {
+		if (LAYER_GET_TYPE(layers[l]) != LStyle_FG)
+			continue;
 
-				grounds[0][position] = TILE_INFO[*ptr & 0xFFF] | (*ptr & 0xF000);
-				if (grounds[1])
-					grounds[1][position] = TILE_INFO[ptr[0x2000] & 0xFFF] | (ptr[0x2000] & 0xF000);
-				// if (background)
-				// 	background[position] = tileset_data[min + (startY * lvl_width) + 0x4000];
-			}
-			startY += dirY;
-		}
-	} while (startX != endX || startY != endY);
+		stream_screen(l, se_mem[(layers[l].gba_meta & 0x1F00) >> 8], layer++);
+	}
 
 skip_loadcam:
 
@@ -625,74 +935,50 @@ skip_loadcam:
 	cam_x += 120;
 	cam_y += 80;
 }
-void reset_cam() {
-	cam_x -= 120;
-	cam_y -= 80;
-
-	protect_cam();
-
-	if (foreground_count == 0)
-		goto skip_loadcam;
-
-	int val;
-
-	int x = INT2BLOCK(cam_x) - 1;
-	int y = INT2BLOCK(cam_y) - 1;
 
-	x &= ~0x1;
+#ifdef PIXTRO_BENCHMARKS
 
-	unsigned short* grounds[3] = {NULL, NULL, NULL};
-
-	int j = 0;
-
-	for (int i = 0; i < 4; ++i) {
-		if (LAYER_GET_TYPE(layers[i]) == LStyle_FG) {
-			grounds[j++] = &se_mem[(layers[i].gba_meta & 0x1F00) >> 8];
-		}
-	}
+// A made up level for benchmarks to scroll around and collide with, with a solid border and scattered blocks.  Takes
+// the place of any loaded level, so only use it before the game loads one
+void load_benchmark_level(int width, int height) {
+	int x, y;
 
-	val = 22;
-	while (val-- > 0) {
+	clear_level_cache();
 
-		int p1 = VIS_BLOCK_POS(x, y);
-		int p2 = (y * lvl_width) + x;
-		++y;
+	lvl_width		 = width;
+	lvl_height		 = height;
+	level_chunked	 = 0;
+	map_width		 = BLOCK2TILE(width);
+	map_height		 = BLOCK2TILE(height);
+	level_layer_size = map_width * map_height;
 
-		int idx = 31 - x;
-
-		for (; idx > 0; idx--) {
-			short* ptr			 = &tileset_data[p2 + idx];
-			grounds[0][p1 + idx] = TILE_INFO[*ptr & 0xFFF] | (*ptr & 0xF000);
-
-			if (grounds[1])
-				grounds[1][p1 + idx] = TILE_INFO[ptr[0x2000] & 0xFFF] | (ptr[0x2000] & 0xF000);
-			// if (background)
-			// 	background[p1 + idx] = tileset_data[p2 + 0x4000 + idx];
-		}
+	tileset_data = LOADED_LEVEL;
 
-		p1 &= 0xFE0;
-		p2 += 32 - x;
+	for (x = 0; x < level_layer_size; ++x)
+		tileset_data[x] = x & 0x3FF;
 
-		for (idx = x; idx > 0; idx--) {
-			short* ptr			 = &tileset_data[p2 + idx];
-			grounds[0][p1 + idx] = TILE_INFO[*ptr & 0xFFF] | (*ptr & 0xF000);
+	level_collision = COLLISION_GRID;
+	reset_collision_grid(level_collision);
 
-			if (grounds[1])
-				grounds[1][p1 + idx] = TILE_INFO[ptr[0x2000] & 0xFFF] | (ptr[0x2000] & 0xF000);
+	for (y = -1; y <= height; ++y) {
+		for (x = -1; x <= width; ++x) {
+			int solid = x <= 0 || y <= 0 || x >= width - 1 || y >= height - 1 || !((x * 7 + y * 13) & 0xF);
 
-			// if (midground)
-			// 	midground[p1 + idx] = tileset_data[p2 + 0x2000 + idx];
-			// if (background)
-			// 	background[p1 + idx] = tileset_data[p2 + 0x4000 + idx];
+			COLLISION_AT(x, y) = solid ? COLLISION_VALUE(1, 0) : 0;
 		}
 	}
-
-skip_loadcam:
-
-	prev_cam_x = cam_x;
-	prev_cam_y = cam_y;
-
-	cam_x += 120;
-	cam_y += 80;
 }
-#endif
\ No newline at end of file
+void unload_benchmark_level() {
+	lvl_width		 = 0;
+	lvl_height		 = 0;
+	map_width		 = 0;
+	map_height		 = 0;
+	level_layer_size = 0;
+
+	memset(layer_scroll_x, 0, sizeof(layer_scroll_x));
+	memset(layer_scroll_y, 0, sizeof(layer_scroll_y));
+	memset(stream_x, 0, sizeof(stream_x));
+	memset(stream_y, 0, sizeof(stream_y));
+}
+
+#endif
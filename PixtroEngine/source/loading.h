@@ -1,5 +1,3 @@
 #pragma once
 
-void load_header(unsigned char *ptr);
-// Set screen fade amount.  Factor should be between 0 and 5
-void fade_black(unsigned int factor);
\ No newline at end of file
+void load_header(unsigned char *ptr);
\ No newline at end of file
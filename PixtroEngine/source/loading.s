@@ -59,104 +59,3 @@
 @ 	str		r0, [r1]
 @ 	bx		lr
 @ @ end load_header
-
-@void fade_black(int factor) factor = 0-5
-@ r0 = factor
-	.align 4
-	.globl fade_black
-	.code 32
-fade_black:
-	
-	@ if fade factor is zero, then set color value to default values
-	cmp		r0, #0
-	beq		.fade_allcolor
-	@ if fade factor is 5 or greater, make screen fully black
-	cmp		r0, #5
-	bge		.fade_allblack
-	
-	push	{lr}
-	
-	@ lr = mask
-	mov		r2, #0
-	mov		r1, r0
-.fade_addloop:
-	lsl		r2, #1
-	add		r2, #1
-	subs	r1, #1
-	bne		.fade_addloop
-	
-	@ r1 = palette pointer
-	mov		r1, #5
-	lsl		r1, #24
-	
-	mov		r3, #5		@ lr <<= 5 - r0
-	sub		r3, r3, r0
-	lsl		r2, r3
-	
-	mov		lr, #1
-	lsl		lr, #10
-	orr		lr, r2
-	lsl		lr, #5
-	orr		lr, r2
-	
-	@ counter for 
-	mov		r3, #512
-	
-	@ r2 = color_bank
-	ldr		r2, =colorbank
-	
-.fade_forloop:
-	
-	push	{r3}
-	ldrh	r3, [r2]
-	lsr		r3,	r0
-	bic		r3, lr
-	strh	r3, [r1]
-	
-	add		r1, #2
-	add		r2, #2
-	
-	pop		{r3}
-	subs	r3, #1
-	bne		.fade_forloop
-	
-	pop		{lr}
-	bx		lr
-
-
-.fade_allblack:
-	mov		r0, #5
-	lsl		r0, #24
-
-	mov		r1, #0
-	
-	mov		r2, #256
-.fadeab_forloop:
-	str		r1, [r0]
-	add		r0, #4
-	
-	subs	r2, #1
-	bne		.fadeab_forloop
-	
-	bx		lr
-	
-	
-.fade_allcolor:
-	@ r0 = palette pointer
-	mov		r0, #5
-	lsl		r0, #24
-
-	@ r1 = color_bank
-	ldr		r1, =colorbank
-	
-	mov		r2, #256
-.fadeac_forloop:
-	ldr		r3, [r1]
-	str		r3, [r0]
-	add		r0, #4
-	add		r1, #4
-	
-	subs	r2, #1
-	bne		.fadeac_forloop
-	
-	bx		lr
\ No newline at end of file
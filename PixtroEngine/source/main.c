@@ -6,6 +6,13 @@
 
 #include "core.h"
 
+void vblank() {
+	// Maxmod has to swap its sound buffers as soon as VBlank starts, or the audio glitches.  The engine's palettes,
+	// sprites and queued copies go straight after
+	mmVBlank();
+	pixtro_vblank();
+}
+
 int main() {
 
 	// Mute game until ready
@@ -14,9 +21,9 @@ int main() {
 	// Initialize maxmod with the soundbank
 	mmInitDefault((mm_addr)soundbank_bin, AUDIO_CHANNELS);
 
-	// Add maxmod VBlank interrupt
+	// Add engine and maxmod VBlank interrupt
 	irq_init(NULL);
-	irq_add(II_VBLANK, mmVBlank);
+	irq_add(II_VBLANK, vblank);
 
 	// Initialize the game engine
 	pixtro_init();
@@ -1,7 +1,5 @@
 #include "math.h"
 
-unsigned int s1 = 0x1234, s2 = 0x4567, s3 = 0x89AB;
-
 const int sine_table[91] = { 
 	0x000, 0x004, 0x009, 0x00D, 0x012, 0x016, 0x01B, 0x01F, 0x024, 0x028, 0x02C, 0x031, 0x035, 0x03A, 0x03E, 0x042, 
 	0x047, 0x04B, 0x04F, 0x053, 0x058, 0x05C, 0x060, 0x064, 0x068, 0x06C, 0x070, 0x074, 0x078, 0x07C, 0x080, 0x084, 
@@ -12,11 +10,18 @@ const int sine_table[91] = {
 };
 
 int int_deg_sin(int angle) {
-	while (angle < 0)
+	// angle / 360, without a divide.  Close enough that it's at most one turn off.  Angles past about two thousand
+	// turns would overflow the multiply, so those get a more precise 64 bit one
+	if ((unsigned int)angle + 737206 <= 737206 * 2)
+		angle -= 360 * ((angle * 0xB61) >> 20);
+	else
+		angle -= 360 * (int)(((long long)angle * 0xB60B60B7LL) >> 40);
+
+	if (angle < 0)
 		angle += 360;
-	while (angle >= 360)
+	else if (angle >= 360)
 		angle -= 360;
-	
+
 	if (angle < 90) {
 		return sine_table[angle];
 	}
@@ -35,6 +40,100 @@ int int_deg_cos(int angle) {
 	return int_deg_sin(angle + 90);
 }
 
+// sin of a binary angle, 256 steps to a full turn
+const short sin_lut[256] = {
+	 0x000,  0x006,  0x00D,  0x013,  0x019,  0x01F,  0x026,  0x02C,  0x032,  0x038,  0x03E,  0x044,  0x04A,  0x050,  0x056,  0x05C,
+	 0x062,  0x068,  0x06D,  0x073,  0x079,  0x07E,  0x084,  0x089,  0x08E,  0x093,  0x098,  0x09D,  0x0A2,  0x0A7,  0x0AC,  0x0B1,
+	 0x0B5,  0x0B9,  0x0BE,  0x0C2,  0x0C6,  0x0CA,  0x0CE,  0x0D1,  0x0D5,  0x0D8,  0x0DC,  0x0DF,  0x0E2,  0x0E5,  0x0E7,  0x0EA,
+	 0x0ED,  0x0EF,  0x0F1,  0x0F3,  0x0F5,  0x0F7,  0x0F8,  0x0FA,  0x0FB,  0x0FC,  0x0FD,  0x0FE,  0x0FF,  0x0FF,  0x100,  0x100,
+	 0x100,  0x100,  0x100,  0x0FF,  0x0FF,  0x0FE,  0x0FD,  0x0FC,  0x0FB,  0x0FA,  0x0F8,  0x0F7,  0x0F5,  0x0F3,  0x0F1,  0x0EF,
+	 0x0ED,  0x0EA,  0x0E7,  0x0E5,  0x0E2,  0x0DF,  0x0DC,  0x0D8,  0x0D5,  0x0D1,  0x0CE,  0x0CA,  0x0C6,  0x0C2,  0x0BE,  0x0B9,
+	 0x0B5,  0x0B1,  0x0AC,  0x0A7,  0x0A2,  0x09D,  0x098,  0x093,  0x08E,  0x089,  0x084,  0x07E,  0x079,  0x073,  0x06D,  0x068,
+	 0x062,  0x05C,  0x056,  0x050,  0x04A,  0x044,  0x03E,  0x038,  0x032,  0x02C,  0x026,  0x01F,  0x019,  0x013,  0x00D,  0x006,
+	 0x000, -0x006, -0x00D, -0x013, -0x019, -0x01F, -0x026, -0x02C, -0x032, -0x038, -0x03E, -0x044, -0x04A, -0x050, -0x056, -0x05C,
+	-0x062, -0x068, -0x06D, -0x073, -0x079, -0x07E, -0x084, -0x089, -0x08E, -0x093, -0x098, -0x09D, -0x0A2, -0x0A7, -0x0AC, -0x0B1,
+	-0x0B5, -0x0B9, -0x0BE, -0x0C2, -0x0C6, -0x0CA, -0x0CE, -0x0D1, -0x0D5, -0x0D8, -0x0DC, -0x0DF, -0x0E2, -0x0E5, -0x0E7, -0x0EA,
+	-0x0ED, -0x0EF, -0x0F1, -0x0F3, -0x0F5, -0x0F7, -0x0F8, -0x0FA, -0x0FB, -0x0FC, -0x0FD, -0x0FE, -0x0FF, -0x0FF, -0x100, -0x100,
+	-0x100, -0x100, -0x100, -0x0FF, -0x0FF, -0x0FE, -0x0FD, -0x0FC, -0x0FB, -0x0FA, -0x0F8, -0x0F7, -0x0F5, -0x0F3, -0x0F1, -0x0EF,
+	-0x0ED, -0x0EA, -0x0E7, -0x0E5, -0x0E2, -0x0DF, -0x0DC, -0x0D8, -0x0D5, -0x0D1, -0x0CE, -0x0CA, -0x0C6, -0x0C2, -0x0BE, -0x0B9,
+	-0x0B5, -0x0B1, -0x0AC, -0x0A7, -0x0A2, -0x09D, -0x098, -0x093, -0x08E, -0x089, -0x084, -0x07E, -0x079, -0x073, -0x06D, -0x068,
+	-0x062, -0x05C, -0x056, -0x050, -0x04A, -0x044, -0x03E, -0x038, -0x032, -0x02C, -0x026, -0x01F, -0x019, -0x013, -0x00D, -0x006,
+};
+
+// (0x1000000 / n) - 0x8000 for n from 256 to 511, used to divide by numbers brought into that range
+const unsigned short reciprocal_table[256] = {
+	0x8000, 0x7F01, 0x7E04, 0x7D09, 0x7C10, 0x7B19, 0x7A23, 0x7930, 0x783E, 0x774E, 0x7660, 0x7574, 0x748A, 0x73A1, 0x72BA, 0x71D5,
+	0x70F1, 0x700F, 0x6F2F, 0x6E50, 0x6D73, 0x6C98, 0x6BBE, 0x6AE5, 0x6A0F, 0x6939, 0x6866, 0x6793, 0x66C3, 0x65F3, 0x6526, 0x6459,
+	0x638E, 0x62C5, 0x61FC, 0x6136, 0x6070, 0x5FAC, 0x5EE9, 0x5E28, 0x5D68, 0x5CA9, 0x5BEB, 0x5B2F, 0x5A74, 0x59BA, 0x5902, 0x584A,
+	0x5794, 0x56DF, 0x562C, 0x5579, 0x54C7, 0x5417, 0x5368, 0x52BA, 0x520D, 0x5161, 0x50B7, 0x500D, 0x4F64, 0x4EBD, 0x4E17, 0x4D71,
+	0x4CCD, 0x4C29, 0x4B87, 0x4AE6, 0x4A46, 0x49A6, 0x4908, 0x486A, 0x47CE, 0x4733, 0x4698, 0x45FE, 0x4566, 0x44CE, 0x4437, 0x43A1,
+	0x430C, 0x4278, 0x41E5, 0x4152, 0x40C1, 0x4030, 0x3FA0, 0x3F11, 0x3E83, 0x3DF6, 0x3D69, 0x3CDD, 0x3C52, 0x3BC8, 0x3B3F, 0x3AB6,
+	0x3A2F, 0x39A8, 0x3921, 0x389C, 0x3817, 0x3793, 0x3710, 0x368D, 0x360B, 0x358A, 0x350A, 0x348A, 0x340B, 0x338D, 0x330F, 0x3292,
+	0x3216, 0x319B, 0x3120, 0x30A6, 0x302C, 0x2FB3, 0x2F3B, 0x2EC3, 0x2E4C, 0x2DD6, 0x2D60, 0x2CEB, 0x2C77, 0x2C03, 0x2B8F, 0x2B1D,
+	0x2AAB, 0x2A39, 0x29C8, 0x2958, 0x28E8, 0x2879, 0x280B, 0x279C, 0x272F, 0x26C2, 0x2656, 0x25EA, 0x257F, 0x2514, 0x24AA, 0x2440,
+	0x23D7, 0x236E, 0x2306, 0x229F, 0x2238, 0x21D1, 0x216B, 0x2106, 0x20A1, 0x203C, 0x1FD8, 0x1F74, 0x1F11, 0x1EAF, 0x1E4D, 0x1DEB,
+	0x1D8A, 0x1D29, 0x1CC9, 0x1C69, 0x1C0A, 0x1BAB, 0x1B4C, 0x1AEE, 0x1A91, 0x1A34, 0x19D7, 0x197B, 0x191F, 0x18C4, 0x1869, 0x180E,
+	0x17B4, 0x175A, 0x1701, 0x16A8, 0x1650, 0x15F8, 0x15A0, 0x1549, 0x14F2, 0x149C, 0x1446, 0x13F0, 0x139B, 0x1346, 0x12F1, 0x129D,
+	0x1249, 0x11F6, 0x11A3, 0x1150, 0x10FE, 0x10AC, 0x105A, 0x1009, 0x0FB8, 0x0F68, 0x0F17, 0x0EC8, 0x0E78, 0x0E29, 0x0DDA, 0x0D8C,
+	0x0D3E, 0x0CF0, 0x0CA3, 0x0C56, 0x0C09, 0x0BBC, 0x0B70, 0x0B24, 0x0AD9, 0x0A8E, 0x0A43, 0x09F8, 0x09AE, 0x0964, 0x091B, 0x08D2,
+	0x0889, 0x0840, 0x07F8, 0x07AF, 0x0768, 0x0720, 0x06D9, 0x0692, 0x064C, 0x0605, 0x05BF, 0x0579, 0x0534, 0x04EF, 0x04AA, 0x0465,
+	0x0421, 0x03DD, 0x0399, 0x0356, 0x0312, 0x02CF, 0x028D, 0x024A, 0x0208, 0x01C6, 0x0185, 0x0143, 0x0102, 0x00C1, 0x0081, 0x0040,
+};
+
+// 1 / x, in fixed point.  Only as precise as the table, so it can be one off
+int fixed_reciprocal(int x) {
+	int sign = x >> 31;
+
+	x = (x ^ sign) - sign;
+
+	if (!x)
+		return 0;
+
+	// Shift x so it's top bit is bit 8, and look up the reciprocal of that
+	int shift = __builtin_clz(x) - 23;
+	int recip;
+
+	if (shift >= 0)
+		recip = reciprocal_table[(x << shift) - 256] + 0x8000;
+	else
+		recip = reciprocal_table[(x >> -shift) - 256] + 0x8000;
+
+	shift = 8 - shift;
+
+	if (shift > 0)
+		recip = (recip + (1 << (shift - 1))) >> shift;
+	else
+		recip <<= -shift;
+
+	return (recip ^ sign) - sign;
+}
+
+// a / b in fixed point.  The table gets the reciprocal close, and two newton steps get the rest of the precision
+int fixed_div(int a, int b) {
+	int sign = (a ^ b) >> 31;
+	unsigned int ua = a < 0 ? -a : a, ub = b < 0 ? -b : b;
+
+	if (!ub)
+		return 0;
+
+	// Normalize b so it's top bit is bit 31, and find 2^63 / b
+	int shift		= __builtin_clz(ub);
+	unsigned int m	= ub << shift;
+	long long recip = (long long)(reciprocal_table[(m >> 23) - 256] + 0x8000) << 16;
+
+	long long error;
+
+	error = (long long)(0x8000000000000000ULL - (unsigned long long)m * recip);
+	recip += ((error >> 32) * recip) >> 31;
+	error = (long long)(0x8000000000000000ULL - (unsigned long long)m * recip);
+	recip += ((error >> 32) * recip) >> 31;
+
+	shift = 55 - shift;
+	int result = (int)(((unsigned long long)ua * recip + (1ULL << (shift - 1))) >> shift);
+
+	return (result ^ sign) - sign;
+}
+
 int fixed_sqrt(int x) {
     unsigned int t, q, b, r;
     r = x;
@@ -57,27 +156,16 @@ int fixed_sqrt(int x) {
 }
 
 AffineMatrix matrix_multiply(AffineMatrix b, AffineMatrix a) {
-	int x, y, i;
-	
 	AffineMatrix ret;
-	
-	int b_values[9];
-	
-	for (x = 0; x < 3; ++x)
-		for (y = 0; y < 2; ++y)
-			b_values[x + (y * 3)] = b.values[x + (y * 3)];
-	
-	b_values[6] = 0;
-	b_values[7] = 0;
-	b_values[8] = 0x100;
-	
-	for (x = 0; x < 3; ++x)
-		for (y = 0; y < 6; y += 3) {
-			ret.values[x + y] = 0;
-			for (i = 0; i < 3; ++i)
-				ret.values[x + y] += FIXED_MULT(a.values[i + y], b_values[x + (i * 3)]);
-		}
-		
+
+	// The bottom row of an affine matrix is always 0, 0, 1, so only the top two rows need working out
+	ret.values[0] = FIXED_MULT(a.values[0], b.values[0]) + FIXED_MULT(a.values[1], b.values[3]);
+	ret.values[1] = FIXED_MULT(a.values[0], b.values[1]) + FIXED_MULT(a.values[1], b.values[4]);
+	ret.values[2] = FIXED_MULT(a.values[0], b.values[2]) + FIXED_MULT(a.values[1], b.values[5]) + a.values[2];
+	ret.values[3] = FIXED_MULT(a.values[3], b.values[0]) + FIXED_MULT(a.values[4], b.values[3]);
+	ret.values[4] = FIXED_MULT(a.values[3], b.values[1]) + FIXED_MULT(a.values[4], b.values[4]);
+	ret.values[5] = FIXED_MULT(a.values[3], b.values[2]) + FIXED_MULT(a.values[4], b.values[5]) + a.values[5];
+
 	return ret;
 }
 AffineMatrix matrix_identity() {
@@ -119,6 +207,16 @@ AffineMatrix matrix_rot(int rot) {
 	
 	return mat;
 }
+AffineMatrix matrix_rot_angle(int angle) {
+	AffineMatrix mat = matrix_identity();
+
+	mat.values[0] =  ANGLE_COS(angle);
+	mat.values[1] = -ANGLE_SIN(angle);
+	mat.values[3] =  ANGLE_SIN(angle);
+	mat.values[4] =  ANGLE_COS(angle);
+
+	return mat;
+}
 AffineMatrix matrix_scale(int scale_x, int scale_y) {
 	AffineMatrix mat = matrix_identity();
 	
@@ -128,6 +226,70 @@ AffineMatrix matrix_scale(int scale_x, int scale_y) {
 	return mat;
 }
 
+// In place versions of multiplying by a transform.  Each only touches the values that would change
+
+void matrix_translate(AffineMatrix* m, int x, int y) {
+	m->values[2] += x;
+	m->values[5] += y;
+}
+void matrix_rotate_sincos(AffineMatrix* m, int sin, int cos) {
+	int i;
+
+	for (i = 0; i < 3; ++i) {
+		int top = m->values[i], bottom = m->values[i + 3];
+
+		m->values[i]	 = FIXED_MULT(cos, top) + FIXED_MULT(-sin, bottom);
+		m->values[i + 3] = FIXED_MULT(sin, top) + FIXED_MULT(cos, bottom);
+	}
+}
+void matrix_rotate(AffineMatrix* m, int angle) {
+	matrix_rotate_sincos(m, ANGLE_SIN(angle), ANGLE_COS(angle));
+}
+void matrix_scale_by(AffineMatrix* m, int scale_x, int scale_y) {
+	m->values[0] = FIXED_MULT(scale_x, m->values[0]);
+	m->values[1] = FIXED_MULT(scale_x, m->values[1]);
+	m->values[2] = FIXED_MULT(scale_x, m->values[2]);
+	m->values[3] = FIXED_MULT(scale_y, m->values[3]);
+	m->values[4] = FIXED_MULT(scale_y, m->values[4]);
+	m->values[5] = FIXED_MULT(scale_y, m->values[5]);
+}
+
+// Transform `count` points, stored as x then y.  `in` and `out` can be the same array
+void transform_points(const AffineMatrix* m, const int* in, int* out, int count) {
+	int a = m->values[0], b = m->values[1], c = m->values[2];
+	int d = m->values[3], e = m->values[4], f = m->values[5];
+
+	while (count--) {
+		int x = in[0], y = in[1];
+
+		out[0] = FIXED_MULT(a, x) + FIXED_MULT(b, y) + c;
+		out[1] = FIXED_MULT(d, x) + FIXED_MULT(e, y) + f;
+
+		in += 2;
+		out += 2;
+	}
+}
+// Same as transform_points, without the translation.  For offsets and directions
+void transform_vectors(const AffineMatrix* m, const int* in, int* out, int count) {
+	int a = m->values[0], b = m->values[1];
+	int d = m->values[3], e = m->values[4];
+
+	while (count--) {
+		int x = in[0], y = in[1];
+
+		out[0] = FIXED_MULT(a, x) + FIXED_MULT(b, y);
+		out[1] = FIXED_MULT(d, x) + FIXED_MULT(e, y);
+
+		in += 2;
+		out += 2;
+	}
+}
+
+#if defined(RNG_LEGACY)
+
+unsigned int s1 = 0x1234, s2 = 0x4567, s3 = 0x89AB;
+
+// Three LCGs added together.  Each step needs a modulo, so this is slow on hardware without a divider
 unsigned int RNG() {
 	s1 = (50000 * s1) % 715827817;
 	s2 = (500001 * s2) % 715827821;
@@ -139,3 +301,94 @@ void rng_seed(unsigned int seed1, unsigned int seed2, unsigned int seed3) {
 	s2 = seed2;
 	s3 = seed3;
 }
+
+#else
+
+// Spread the three seeds out into a full state, so similar seeds still start far apart
+unsigned int splitmix32(unsigned int* x) {
+	unsigned int z = (*x += 0x9E3779B9);
+
+	z = (z ^ (z >> 16)) * 0x85EBCA6B;
+	z = (z ^ (z >> 13)) * 0xC2B2AE35;
+	return z ^ (z >> 16);
+}
+
+#if defined(RNG_PCG32)
+
+unsigned long long pcg_state, pcg_inc;
+
+// PCG32, the XSH RR variant
+unsigned int RNG() {
+	unsigned long long old = pcg_state;
+
+	pcg_state = old * 6364136223846793005ULL + pcg_inc;
+
+	unsigned int xorshifted = (unsigned int)(((old >> 18) ^ old) >> 27);
+	unsigned int rot		= (unsigned int)(old >> 59);
+
+	return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+void rng_seed(unsigned int seed1, unsigned int seed2, unsigned int seed3) {
+	unsigned int mix = seed1;
+
+	// Each seed is hashed before the next one goes in, so seeds can't cancel each other out
+	mix = splitmix32(&mix) ^ seed2;
+	mix = splitmix32(&mix) ^ seed3;
+
+	pcg_state = ((unsigned long long)splitmix32(&mix) << 32) | splitmix32(&mix);
+	// The increment has to be odd
+	pcg_inc = ((unsigned long long)splitmix32(&mix) << 32) | splitmix32(&mix) | 1;
+}
+
+#else
+
+unsigned int xoshiro[4];
+
+#define ROTL(x, k) (((x) << (k)) | ((x) >> (32 - (k))))
+
+// xoshiro128**, only shifts, rotates and a couple multiplies that become shifts and adds
+unsigned int RNG() {
+	unsigned int result = ROTL(xoshiro[1] * 5, 7) * 9;
+	unsigned int t		= xoshiro[1] << 9;
+
+	xoshiro[2] ^= xoshiro[0];
+	xoshiro[3] ^= xoshiro[1];
+	xoshiro[1] ^= xoshiro[2];
+	xoshiro[0] ^= xoshiro[3];
+
+	xoshiro[2] ^= t;
+	xoshiro[3] = ROTL(xoshiro[3], 11);
+
+	return result;
+}
+void rng_seed(unsigned int seed1, unsigned int seed2, unsigned int seed3) {
+	unsigned int mix = seed1;
+
+	xoshiro[0] = splitmix32(&mix);
+	mix ^= seed2;
+	xoshiro[1] = splitmix32(&mix);
+	mix ^= seed3;
+	xoshiro[2] = splitmix32(&mix);
+	xoshiro[3] = splitmix32(&mix);
+}
+
+#endif
+#endif
+
+void rng_fill(unsigned int* buffer, int count) {
+	while (count-- > 0)
+		*buffer++ = RNG();
+}
+// A random number from 0 to range - 1.  Uses the top bits of a multiply instead of a modulo
+unsigned int rng_bounded(unsigned int range) {
+#if defined(RNG_LEGACY)
+	// The legacy generator's top bits aren't evenly spread, so it has to use the low bits
+	return RNG() % range;
+#else
+	return (unsigned int)(((unsigned long long)RNG() * range) >> 32);
+#endif
+}
+// A random number from min to max - 1
+int rng_range(int min, int max) {
+	return min + (int)rng_bounded(max - min);
+}
@@ -9,7 +9,7 @@
 #define INT2BLOCK(n)   ((n) >> (BLOCK_SHIFT))
 #define BLOCK2INT(n)   ((n) << (BLOCK_SHIFT))
 
-#define FIXED_DIV(a, b)	 (INT2FIXED(a) / (b))
+#define FIXED_DIV(a, b)	 fixed_div((a), (b))
 #define FIXED_MULT(a, b) (FIXED2INT((a) * (b)))
 
 #define INT_ABS(n)				((n) * (((n) >> 31) | 1))
@@ -29,10 +29,20 @@
 
 #define ACC 8
 
-#define TRANSLATE_MATRIX(m, x, y) m = matrix_multiply(m, matrix_trans(x, y))
-#define ROTATE_MATRIX(m, r)		  m = matrix_multiply(m, matrix_rot(r))
-#define SCALE_MATRIX(m, s)		  m = matrix_multiply(m, matrix_scale(s, s))
-#define SCALE_MATRIX_XY(m, x, y)  m = matrix_multiply(m, matrix_scale(x, y))
+// Binary angles, where a full turn is ANGLE_STEPS.  DEG2ANGLE is within one step for up to 100 turns either way
+#define ANGLE_STEPS	   256
+#define ANGLE_MASK	   (ANGLE_STEPS - 1)
+#define DEG2ANGLE(d)   ((((d) * 0xB60B) + 0x8000) >> 16)
+#define ANGLE_SIN(a)   (sin_lut[(a) & ANGLE_MASK])
+#define ANGLE_COS(a)   (sin_lut[((a) + (ANGLE_STEPS >> 2)) & ANGLE_MASK])
+
+#define TRANSLATE_MATRIX(m, x, y)	matrix_translate(&(m), x, y)
+#define ROTATE_MATRIX(m, r)			matrix_rotate_sincos(&(m), int_deg_sin(r), int_deg_cos(r))
+#define ROTATE_MATRIX_ANGLE(m, a)	matrix_rotate(&(m), a)
+#define SCALE_MATRIX(m, s)			matrix_scale_by(&(m), s, s)
+#define SCALE_MATRIX_XY(m, x, y)	matrix_scale_by(&(m), x, y)
+
+extern const short sin_lut[256];
 
 typedef struct AffineMatrix {
 	int values[6];
@@ -44,7 +54,32 @@ AffineMatrix matrix_multiply(AffineMatrix a, AffineMatrix b);
 AffineMatrix matrix_identity();
 AffineMatrix matrix_trans(int x, int y);
 AffineMatrix matrix_rot(int rot);
+AffineMatrix matrix_rot_angle(int angle);
 AffineMatrix matrix_scale(int scale_x, int scale_y);
 
+void matrix_translate(AffineMatrix* m, int x, int y);
+void matrix_rotate(AffineMatrix* m, int angle);
+void matrix_rotate_sincos(AffineMatrix* m, int sin, int cos);
+void matrix_scale_by(AffineMatrix* m, int scale_x, int scale_y);
+
+void transform_points(const AffineMatrix* m, const int* in, int* out, int count);
+void transform_vectors(const AffineMatrix* m, const int* in, int* out, int count);
+
+int int_deg_sin(int angle);
+int int_deg_cos(int angle);
+
 int fixed_sqrt(int x);
+int fixed_reciprocal(int x);
+int fixed_div(int a, int b);
+// Random number generators.  Define one of these in engine.h to choose which one RNG() uses, xoshiro128** is used
+// if none are defined.  RNG_LEGACY is the original generator, and needs 3 divides per number
+// RNG_LEGACY, RNG_PCG32, RNG_XOSHIRO
+#if !defined(RNG_LEGACY) && !defined(RNG_PCG32) && !defined(RNG_XOSHIRO)
+#define RNG_XOSHIRO
+#endif
+
 unsigned int RNG();
+void rng_seed(unsigned int seed1, unsigned int seed2, unsigned int seed3);
+void rng_fill(unsigned int* buffer, int count);
+unsigned int rng_bounded(unsigned int range);
+int rng_range(int min, int max);
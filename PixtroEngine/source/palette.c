@@ -0,0 +1,193 @@
+#include "palette.h"
+#include <string.h>
+
+#include "tonc_vscode.h"
+
+// Every other 5 bit channel of two colors packed into a word, with 11 bits of space above each to blend in
+#define CHANNEL_MASK 0x001F001F
+
+// 16 colors to a bank, 2 colors to a word
+#define BANK_WORDS 8
+
+extern unsigned short colorbank[512];
+
+// Palettes with effects applied, waiting to be copied to palette ram
+unsigned short palette_buffer[512];
+
+unsigned int palette_banks_used;
+// Banks that need to be recalculated, and banks waiting to be copied in VBlank.  The VBlank interrupt clears
+// palette_commit, so interrupts are turned off while adding to it
+volatile unsigned int palette_refresh, palette_commit;
+
+// Mark banks to be copied next VBlank, without the interrupt clearing them between the read and the write
+static inline void commit_banks(unsigned int banks) {
+	unsigned short ime = REG_IME;
+
+	REG_IME = 0;
+	palette_commit |= banks;
+	REG_IME = ime;
+}
+
+unsigned short fade_color;
+
+int palette_fade_color, palette_fade_amount;
+const unsigned short* palette_cross_target;
+int palette_cross_amount;
+
+unsigned short flash_color[32];
+unsigned char flash_timer[32], flash_length[32];
+unsigned int palette_flashing;
+
+// Blend words of two colors from `from` towards `to`, with amount out of PAL_BLEND_MAX
+HOT_CODE void blend_words(unsigned int* out, const unsigned int* from, const unsigned int* to, int amount, int count) {
+	int inverse = PAL_BLEND_MAX - amount;
+
+	while (count--) {
+		unsigned int a = *from++, b = *to++;
+
+		unsigned int red   = (((a & CHANNEL_MASK) * inverse + (b & CHANNEL_MASK) * amount) >> 5) & CHANNEL_MASK;
+		unsigned int green = ((((a >> 5) & CHANNEL_MASK) * inverse + ((b >> 5) & CHANNEL_MASK) * amount) >> 5) & CHANNEL_MASK;
+		unsigned int blue  = ((((a >> 10) & CHANNEL_MASK) * inverse + ((b >> 10) & CHANNEL_MASK) * amount) >> 5) & CHANNEL_MASK;
+
+		*out++ = red | (green << 5) | (blue << 10);
+	}
+}
+// Same as blend_words, but towards a single color
+HOT_CODE void blend_words_color(unsigned int* out, const unsigned int* from, int color, int amount, int count) {
+	int inverse = PAL_BLEND_MAX - amount;
+
+	color &= 0x7FFF;
+	color |= color << 16;
+
+	unsigned int red   = (color & CHANNEL_MASK) * amount;
+	unsigned int green = ((color >> 5) & CHANNEL_MASK) * amount;
+	unsigned int blue  = ((color >> 10) & CHANNEL_MASK) * amount;
+
+	while (count--) {
+		unsigned int a = *from++;
+
+		*out++ = ((((a & CHANNEL_MASK) * inverse + red) >> 5) & CHANNEL_MASK) |
+				 (((((a >> 5) & CHANNEL_MASK) * inverse + green) >> 5) & CHANNEL_MASK) << 5 |
+				 (((((a >> 10) & CHANNEL_MASK) * inverse + blue) >> 5) & CHANNEL_MASK) << 10;
+	}
+}
+
+void palette_fade(int color, int amount) {
+	if (amount < 0)
+		amount = 0;
+	if (amount > PAL_BLEND_MAX)
+		amount = PAL_BLEND_MAX;
+
+	if (amount == palette_fade_amount && (color == palette_fade_color || !amount))
+		return;
+
+	palette_fade_color	= color;
+	palette_fade_amount = amount;
+	palette_refresh |= palette_banks_used;
+}
+void palette_crossfade(const unsigned short* target, int amount) {
+	if (amount < 0)
+		amount = 0;
+	if (amount > PAL_BLEND_MAX)
+		amount = PAL_BLEND_MAX;
+
+	if (!target)
+		amount = 0;
+
+	if (amount == palette_cross_amount && (target == palette_cross_target || !amount))
+		return;
+
+	palette_cross_target = target;
+	palette_cross_amount = amount;
+	palette_refresh |= palette_banks_used;
+}
+void palette_flash(int bank, int color, int frames) {
+	if (frames <= 0 || !(palette_banks_used & (1 << bank)))
+		return;
+	if (frames > 255)
+		frames = 255;
+
+	flash_color[bank]  = color;
+	flash_timer[bank]  = frames;
+	flash_length[bank] = frames;
+
+	palette_flashing |= 1 << bank;
+}
+
+void refresh_palette_bank(int bank) {
+	palette_banks_used |= 1 << bank;
+
+	// With no effects on the bank, the colors can go straight to the next VBlank
+	if (!palette_fade_amount && !palette_cross_amount && !(palette_flashing & (1 << bank))) {
+		memcpy(&palette_buffer[bank << 4], &colorbank[bank << 4], BANK_WORDS << 2);
+		commit_banks(1 << bank);
+	} else {
+		palette_refresh |= 1 << bank;
+	}
+}
+
+// Work out the colors of every bank that changed this frame
+void update_palettes() {
+	unsigned int banks = (palette_refresh | palette_flashing) & palette_banks_used;
+	unsigned int done  = banks;
+
+	palette_refresh = 0;
+
+	int bank;
+	for (bank = 0; banks; ++bank, banks >>= 1) {
+		if (!(banks & 1))
+			continue;
+
+		unsigned int* dst		= (unsigned int*)&palette_buffer[bank << 4];
+		const unsigned int* src = (unsigned int*)&colorbank[bank << 4];
+
+		if (palette_cross_amount) {
+			blend_words(dst, src, (unsigned int*)&palette_cross_target[bank << 4], palette_cross_amount, BANK_WORDS);
+			src = dst;
+		}
+		if (palette_fade_amount) {
+			blend_words_color(dst, src, palette_fade_color, palette_fade_amount, BANK_WORDS);
+			src = dst;
+		}
+		if (flash_timer[bank]) {
+			blend_words_color(dst, src, flash_color[bank], (flash_timer[bank] * PAL_BLEND_MAX) / flash_length[bank], BANK_WORDS);
+			src = dst;
+
+			// Once the flash is over, the bank needs to go back to normal next frame
+			if (!--flash_timer[bank]) {
+				palette_flashing &= ~(1 << bank);
+				palette_refresh |= 1 << bank;
+			}
+		}
+
+		if (src != dst)
+			memcpy(dst, src, BANK_WORDS << 2);
+	}
+
+	commit_banks(done);
+}
+
+// Copy finished banks into palette ram.  Runs during VBlank so palettes don't change mid frame
+void palette_vblank() {
+	unsigned int banks = palette_commit;
+	int bank = 0, start;
+
+	palette_commit = 0;
+
+	while (banks) {
+		if (!(banks & 1)) {
+			bank++;
+			banks >>= 1;
+			continue;
+		}
+
+		// Copy banks that are next to each other all at once
+		start = bank;
+		while (banks & 1) {
+			bank++;
+			banks >>= 1;
+		}
+
+		dma3_cpy(&pal_bg_mem[start << 4], &palette_buffer[start << 4], (bank - start) * (BANK_WORDS << 2));
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "core.h"
+
+// ---- Palette effects ----
+//
+// Effects are worked out from colorbank (the palettes loaded with load_bg_pal and load_obj_pal) into a buffer,
+// which is copied into palette ram during VBlank.  Only banks that have been loaded, and have changed, get updated
+
+// Palette banks, 0-15 are background banks and 16-31 are sprite banks
+#define PAL_BG_BANK(n)	(n)
+#define PAL_OBJ_BANK(n) ((n) + 16)
+
+// The max amount of an effect.  A fade at PAL_BLEND_MAX is fully the fade color
+#define PAL_BLEND_MAX 32
+
+// Banks that have palettes loaded into them
+extern unsigned int palette_banks_used;
+// The color the screen fades to when using start_fading
+extern unsigned short fade_color;
+
+// Fade the whole screen towards a color
+void palette_fade(int color, int amount);
+// Fade every used bank towards a full palette of 512 colors (background, then sprites).  Set to NULL to stop
+void palette_crossfade(const unsigned short* target, int amount);
+// Flash a bank to a color, fading back to normal over the given amount of frames
+void palette_flash(int bank, int color, int frames);
+
+// Mark a bank to be recalculated, for when it's colors in colorbank have changed
+void refresh_palette_bank(int bank);
+
+void update_palettes();
+void palette_vblank();
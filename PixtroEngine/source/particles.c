@@ -2,164 +2,291 @@
 #include <string.h>
 
 #include "core.h"
+#include "dma_queue.h"
+#include "graphics.h"
 #include "math.h"
 #include "particles.h"
 #include "sprites.h"
 
-// Life time			(8 bits)
-// X vel				(8 bits  (X.X))
-// X Coor				(16 bits (XXX.X))
-#define ATT1_LIFE	0xFF000000
-#define ATT1_LIFE_1 0x01000000
-
-// Animation frame		(4 bits)
-// Color index			(4 bits)
-// Y vel				(8 bits  (X.X))
-// Y Coor				(16 bits (XXX.X))
-#define ATT2_ANIMFRAME		0xF0000000
-#define ATT2_ANIMFRAME_TICK 0x10000000
-#define ATT2_PAL			0x0F000000
-#define ATT2_PAL_S			24
-
-// Default Life Time 	(8 bits)
-// ???
-// Gravity				(2 bits)
-// Priority				(2 bits)
-// Flip Data			(2 bits)
-// Particle Frame start	(8 bits)
-#define ATT3_DEF_LIFE		0xFF000000
-#define ATT3_DEF_LIFE_SHIFT 0
-#define ATT3_GRAV_1			0x00010000
-#define ATT3_GRAV_S			0x00020000
-#define ATT3_PRIO			0x0000C000
-#define ATT3_PRIO_S			12
-#define ATT3_FLIP			0x00003000
-#define ATT3_START_FRAME	0x00000FFF
-
-#define PARTICLE_MAX	   288 // 96 * 3
-#define PARTICLE_DATA_SIZE 3
-
-unsigned int particle_data[PARTICLE_MAX];
-int lastParticle;
-
-#define PARTICLE_FRAME(i) (((particle_data[i + 1] & ATT2_ANIMFRAME) >> 28) + (particle_data[i + 2] & ATT3_START_FRAME)) << 3
-
-void add_particle(int att1, int att2, int att3);
-
-extern const int particles[];
-
-extern int sprite_count;
-extern OBJ_ATTR* sprite_pointer;
+// PART_ values hold the first frame, and the amount of frames after it
+#define PART_START(p)  ((p)&0xFFF)
+#define PART_LENGTH(p) (((p)&0xF000) >> 12)
+
+// The amount of frames every particle has together, worked out by the compiler
+#ifndef PARTICLE_FRAMES
+#define PARTICLE_FRAMES 256
+#endif
+
+// Particles use the tiles before the sprite banks, one frame to a tile
+#define PARTICLE_TILES BANK_MEM_START
+
+// Random amount from -spread to spread, using the bottom 8 bits of rng
+#define RANDOM_SPREAD(rng, spread) ((((int)((rng)&0xFF) - 0x80) * (spread)) >> 7)
+
+// Live particles are packed at the start of each array.  Positions and velocities are fixed point
+int particle_count;
+int particle_x[PARTICLE_LIMIT], particle_y[PARTICLE_LIMIT];
+short particle_vel_x[PARTICLE_LIMIT], particle_vel_y[PARTICLE_LIMIT], particle_gravity[PARTICLE_LIMIT];
+// The frame showing, and the first frame of the particle.  Frames are stored backwards, so animations count down
+unsigned short particle_frame[PARTICLE_LIMIT], particle_start[PARTICLE_LIMIT];
+// Frames left until the next animation frame, and the frames each animation frame lasts
+unsigned char particle_timer[PARTICLE_LIMIT], particle_frame_time[PARTICLE_LIMIT];
+unsigned char particle_tile[PARTICLE_LIMIT];
+// Flip, palette and priority bits of the particle's sprite
+unsigned short particle_attr1[PARTICLE_LIMIT], particle_attr2[PARTICLE_LIMIT];
+
+// The tile each frame is loaded into and the frame loaded into each tile, both plus one so 0 means none
+unsigned char frame_tile[PARTICLE_FRAMES];
+unsigned short tile_frame[PARTICLE_TILES];
+// The amount of live particles showing each tile
+unsigned short tile_refs[PARTICLE_TILES];
+int next_tile;
+
+ParticleEmitter particle_emitters[EMITTER_LIMIT];
+
 extern int cam_x, cam_y;
+extern OBJ_ATTR* sprite_pointer;
+
+// Get the tile a frame is loaded into, loading it if it isn't.  Returns -1 if every tile is being shown
+static int use_frame(int frame) {
+	int tile = frame_tile[frame] - 1;
+
+	if (tile < 0) {
+		int i;
+
+		// Go round the tiles, so frames that stopped being used recently stay loaded for a while
+		for (i = 0; i < PARTICLE_TILES; ++i) {
+			tile = next_tile;
+
+			if (++next_tile == PARTICLE_TILES)
+				next_tile = 0;
+
+			if (!tile_refs[tile])
+				break;
+		}
+
+		if (tile_refs[tile])
+			return -1;
+
+		if (tile_frame[tile])
+			frame_tile[tile_frame[tile] - 1] = 0;
+
+		tile_frame[tile]  = frame + 1;
+		frame_tile[frame] = tile + 1;
+
+		dma_queue_push(&tile_mem[4][tile], &particles[frame << 3], 32);
+	}
+
+	tile_refs[tile]++;
+
+	return tile;
+}
+
+static int spawn_particle(int x, int y, int vel_x, int vel_y, int gravity, int particle, int frame_time, int attr1, int attr2) {
+	if (particle_count >= PARTICLE_LIMIT)
+		return 0;
+
+	int frame = PART_START(particle) + PART_LENGTH(particle);
+
+	if (frame >= PARTICLE_FRAMES)
+		return 0;
+
+	int tile = use_frame(frame);
+
+	if (tile < 0)
+		return 0;
+
+	int i = particle_count++;
+
+	particle_x[i]		   = x;
+	particle_y[i]		   = y;
+	particle_vel_x[i]	   = vel_x;
+	particle_vel_y[i]	   = vel_y;
+	particle_gravity[i]	   = gravity;
+	particle_frame[i]	   = frame;
+	particle_start[i]	   = PART_START(particle);
+	particle_timer[i]	   = frame_time;
+	particle_frame_time[i] = frame_time;
+	particle_tile[i]	   = tile;
+	particle_attr1[i]	   = attr1;
+	particle_attr2[i]	   = attr2;
+
+	return 1;
+}
+
+// Remove a particle by moving the last one into its place
+static void remove_particle(int i) {
+	int last = --particle_count;
+
+	tile_refs[particle_tile[i]]--;
+
+	if (i == last)
+		return;
+
+	particle_x[i]		   = particle_x[last];
+	particle_y[i]		   = particle_y[last];
+	particle_vel_x[i]	   = particle_vel_x[last];
+	particle_vel_y[i]	   = particle_vel_y[last];
+	particle_gravity[i]	   = particle_gravity[last];
+	particle_frame[i]	   = particle_frame[last];
+	particle_start[i]	   = particle_start[last];
+	particle_timer[i]	   = particle_timer[last];
+	particle_frame_time[i] = particle_frame_time[last];
+	particle_tile[i]	   = particle_tile[last];
+	particle_attr1[i]	   = particle_attr1[last];
+	particle_attr2[i]	   = particle_attr2[last];
+}
 
 void add_particle_basic(int x, int y, int particle, int frame_time, int pal, int priority) {
 
 	if (!frame_time || !particle)
 		return;
 
-	int rng = RNG();
+	if (frame_time > 0xFF)
+		frame_time = 0xFF;
 
-	x <<= 4;
-	y <<= 4;
+	unsigned int rng = RNG();
 
-	x |= frame_time << 24;
-	int vel = rng & 0x7F;
-	vel /= 5;
-	if (rng & 0x80)
-		vel = ~vel;
-	rng >>= 8;
-	x |= (vel << 16) & 0xFF0000;
+	spawn_particle(INT2FIXED(x), INT2FIXED(y), RANDOM_SPREAD(rng, 0x190), RANDOM_SPREAD(rng >> 8, 0x190), PGRAVITY_LIGHT,
+				   particle, frame_time, 0, ATTR2_PALBANK(pal) | ATTR2_PRIO(priority));
+}
 
-	y |= (particle & 0xF000) << 16;
-	vel = rng & 0x7F;
-	vel /= 5;
-	if (rng & 0x80)
-		vel = ~vel;
-	rng >>= 8;
-	y |= (vel << 16) & 0xFF0000;
+int add_emitter(int x, int y, int particle, int rate, int lifetime) {
+	int i;
 
-	particle &= ATT3_START_FRAME;
-	particle |= priority << ATT3_PRIO_S;
-	particle |= frame_time << 24;
+	for (i = 0; i < EMITTER_LIMIT; ++i) {
+		ParticleEmitter* emitter = &particle_emitters[i];
+
+		if (emitter->active)
+			continue;
+
+		memset(emitter, 0, sizeof(ParticleEmitter));
+
+		emitter->x		  = x;
+		emitter->y		  = y;
+		emitter->spread_x = 0x100;
+		emitter->spread_y = 0x100;
+		emitter->gravity  = PGRAVITY_LIGHT;
+		emitter->rate	  = rate;
+		emitter->lifetime = lifetime;
+		emitter->particle = particle;
+		emitter->active	  = 1;
+
+		return i;
+	}
 
-	add_particle(x, y, particle);
+	return -1;
 }
+void remove_emitter(int emitter) {
+	particle_emitters[emitter].active = 0;
+}
+void emit_particles(int emitter, int count) {
+	ParticleEmitter* e = &particle_emitters[emitter];
+
+	// The particle's lifetime is split evenly between its frames
+	int frame_time = e->lifetime / (PART_LENGTH(e->particle) + 1);
 
-void add_particle(int att1, int att2, int att3) {
+	if (frame_time < 1)
+		frame_time = 1;
+	if (frame_time > 0xFF)
+		frame_time = 0xFF;
 
-	particle_data[lastParticle]		= att1;
-	particle_data[lastParticle + 1] = att2;
-	particle_data[lastParticle + 2] = att3;
+	int attr2 = ATTR2_PALBANK(e->pal) | ATTR2_PRIO(e->prio);
 
-	memcpy(&tile_mem[4][lastParticle / 3], &particles[PARTICLE_FRAME(lastParticle)], 32);
+	while (count--) {
+		unsigned int rng = RNG();
 
-	lastParticle += 3;
-	lastParticle %= PARTICLE_MAX;
+		if (!spawn_particle(e->x, e->y, e->vel_x + RANDOM_SPREAD(rng, e->spread_x), e->vel_y + RANDOM_SPREAD(rng >> 8, e->spread_y),
+							e->gravity, e->particle, frame_time, e->flip, attr2))
+			break;
+	}
 }
 
-void update_particles() {
-	int index, moveParticles = 1;
-	int sp = 0;
+HOT_CODE void update_particles() {
+	int i;
 
 #ifdef __DEBUG__
 	if (ENGINE_DEBUGFLAG(PAUSE_UPDATES))
-		moveParticles = 0;
+		return;
 #endif
 
-	for (index = 0; index < PARTICLE_MAX; index += PARTICLE_DATA_SIZE) {
-		if (!(particle_data[index] & ATT1_LIFE)) {
-			if (particle_data[index + 1] & ATT2_ANIMFRAME) {
-				particle_data[index + 1] -= ATT2_ANIMFRAME_TICK;
-				particle_data[index] |= ((particle_data[index + 2] & ATT3_DEF_LIFE));
+	for (i = 0; i < EMITTER_LIMIT; ++i) {
+		ParticleEmitter* emitter = &particle_emitters[i];
 
-				memcpy(&tile_mem[4][index / 3], &particles[PARTICLE_FRAME(index)], 32);
-			} else
-				continue;
-		}
+		if (!emitter->active)
+			continue;
 
-		particle_data[index] -= ATT1_LIFE_1 * moveParticles;
+		int timer = emitter->rate_timer + emitter->rate;
 
-		// X Velocity
-		int pos = particle_data[index] & 0xFFFF;
-		int vel = ((particle_data[index] & 0x7F0000) >> 16) | ((particle_data[index] & 0x800000) ? 0xFFFFFF80 : 0);
-		pos += vel * moveParticles;
-		pos &= 0xFFFF;
-		particle_data[index] = pos | (particle_data[index] & 0xFFFF0000);
+		if (timer >= 0x100)
+			emit_particles(i, timer >> 8);
 
-		pos = (pos >> 4) - cam_x;
-		if (pos < -8 || pos > 240) {
-			particle_data[index] &= ~ATT1_LIFE;
-			continue;
+		emitter->rate_timer = timer & 0xFF;
+
+		if (emitter->duration && !--emitter->duration)
+			emitter->active = 0;
+	}
+
+	// Particles that leave the screen are removed
+	int left = INT2FIXED(cam_x - 128), right = INT2FIXED(cam_x + 120),
+		top = INT2FIXED(cam_y - 88), bottom = INT2FIXED(cam_y + 80);
+
+	for (i = 0; i < particle_count;) {
+		if (!--particle_timer[i]) {
+			int tile;
+
+			if (particle_frame[i] == particle_start[i] || (tile = use_frame(particle_frame[i] - 1)) < 0) {
+				remove_particle(i);
+				continue;
+			}
+
+			tile_refs[particle_tile[i]]--;
+
+			particle_frame[i]--;
+			particle_tile[i]  = tile;
+			particle_timer[i] = particle_frame_time[i];
 		}
 
-		pos = particle_data[index + 1] & 0xFFFF;
-		vel = ((particle_data[index + 1] & 0x7F0000) >> 16) | ((particle_data[index + 1] & 0x800000) ? 0xFFFFFF80 : 0);
-		vel += ((((particle_data[index + 2] & ATT3_GRAV_1) >> 8) | (particle_data[index + 2] & ATT3_GRAV_S ? 0xFFFFFFFE : 0)) + 1) * moveParticles;
-		pos += vel * moveParticles;
-		pos &= 0xFFFF;
-		particle_data[index + 1] = pos | (particle_data[index + 1] & 0xFF000000) | ((vel & 0xFF) << 16);
+		particle_vel_y[i] += particle_gravity[i];
+		particle_x[i] += particle_vel_x[i];
+		particle_y[i] += particle_vel_y[i];
 
-		pos = (pos >> 4) - cam_y;
-		if (pos < -8 || pos > 160) {
-			particle_data[index] &= ~ATT1_LIFE;
+		if (particle_x[i] < left || particle_x[i] > right || particle_y[i] < top || particle_y[i] > bottom) {
+			remove_particle(i);
 			continue;
 		}
 
-		vel = ((particle_data[index] & 0xFFFF) >> 4) - cam_x;
+		++i;
+	}
+}
+// Draw particles with the sprites left over once everything else has been drawn
+HOT_CODE void draw_particles() {
+	int i, drawn = 0, limit = SPRITE_LIMIT - sprite_count;
+	int left = cam_x - 120, top = cam_y - 80;
+
+	OBJ_ATTR* obj = sprite_pointer;
+
+	for (i = 0; i < particle_count && drawn < limit; ++i) {
+		int x = FIXED2INT(particle_x[i]) - left,
+			y = FIXED2INT(particle_y[i]) - top;
 
-		obj_set_attr((sprite_pointer + (sp++)),
-					 ATTR0_SQUARE | ATTR0_Y(pos),																															// ATTR0
-					 ATTR1_SIZE_8 | ATTR1_X(vel) | ((particle_data[index + 2] & ATT3_FLIP) << 2),																			// ATTR1
-					 ATTR2_PALBANK((particle_data[index + 1] & ATT2_PAL) >> ATT2_PAL_S) | (index / 3) | ATTR2_PRIO((particle_data[index + 2] & ATT3_PRIO) >> ATT3_PRIO_S)); // ATTR2
+		// Particles spawned since the last update might not be on screen
+		if ((unsigned int)(x + 8) > 248 || (unsigned int)(y + 8) > 168)
+			continue;
+
+		obj_set_attr(obj++,
+					 ATTR0_SQUARE | ATTR0_Y(y),
+					 ATTR1_SIZE_8 | ATTR1_X(x) | particle_attr1[i],
+					 particle_attr2[i] | particle_tile[i]);
+		++drawn;
 	}
 
-	sprite_count += sp;
-	sprite_pointer += sp;
+	sprite_count += drawn;
+	sprite_pointer = obj;
 }
-void ClearParticles() {
-	int index;
-	for (index = 0; index < PARTICLE_MAX; index += PARTICLE_DATA_SIZE) {
-		particle_data[index]	 = 0;
-		particle_data[index + 1] = 0;
-	}
+void clear_particles() {
+	particle_count = 0;
+
+	memset(tile_refs, 0, sizeof(tile_refs));
+	memset(particle_emitters, 0, sizeof(particle_emitters));
 }
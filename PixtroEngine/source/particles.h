@@ -1,24 +1,57 @@
 #pragma once
 #include "_pix_particles.h"
 
-#define PGRAVITY_LIGHT	 0
-#define PGRAVITY_HEAVY	 1
-#define PGRAVITY_REVERSE 2
-#define PGRAVITY_NONE	 3
-
-// Life time			(4 bits)
-// Default Life Time 	(4 bits)
-// X vel				(8 bits  (X.X))
-// X Coor				(16 bits (XXX.X))
-
-// Animation frame		(2 bits)
-// Priority				(2 bits)
-// Color index			(4 bits)
-// Y vel				(8 bits  (X.X))
-// Y Coor				(16 bits (XXX.X))
-
-// Flip Data			(2 bits)
-// Gravity				(2 bits)
-// Particle Frame start	(8 bits)
+// ---- Particles ----
+//
+// Live particles are packed together, so dead ones are never looked at.  Each frame of a particle's animation is
+// loaded into one of the tiles before the sprite banks the first time it's used, and every particle showing that
+// frame shares the tile.  Particles are drawn after everything else, using whatever sprites are left over
 
+// The max amount of particles alive at once.  Only as many as there are sprites left over each frame get drawn
+#ifndef PARTICLE_LIMIT
+#define PARTICLE_LIMIT 128
+#endif
+// The max amount of emitters
+#ifndef EMITTER_LIMIT
+#define EMITTER_LIMIT 16
+#endif
+
+// Fixed point gravity, added to a particle's y velocity each frame
+#define PGRAVITY_LIGHT	 0x10
+#define PGRAVITY_HEAVY	 0x20
+#define PGRAVITY_REVERSE -0x10
+#define PGRAVITY_NONE	 0
+
+typedef struct {
+	// Fixed point position in the level
+	int x, y;
+	// Fixed point starting velocity, and the most that can be randomly added or taken away from it
+	short vel_x, vel_y, spread_x, spread_y;
+	short gravity;
+	// Particles spawned each frame, fixed point.  0x80 would be one every other frame
+	unsigned short rate, rate_timer;
+	// Frames each particle lives, split between the frames of its animation
+	unsigned short lifetime;
+	// Frames until the emitter removes itself, or 0 to keep going until removed
+	unsigned short duration;
+	// PART_ value of the particle spawned
+	unsigned short particle;
+	// FLIP_ value of the particles
+	unsigned short flip;
+	unsigned char pal, prio, active;
+} ParticleEmitter;
+
+extern ParticleEmitter particle_emitters[EMITTER_LIMIT];
+extern int particle_count;
+
+// Spawn a single particle at a pixel position, moving in a random direction
 void add_particle_basic(int x, int y, int particle, int frame_time, int pal, int priority);
+
+// Start an emitter at a fixed point position, spawning `rate` particles a frame that each live for `lifetime` frames.
+// Returns the emitter's index, or -1 if there are none left.  Other settings can be changed in particle_emitters
+int add_emitter(int x, int y, int particle, int rate, int lifetime);
+void remove_emitter(int emitter);
+// Spawn `count` particles from an emitter at once
+void emit_particles(int emitter, int count);
+
+void clear_particles();
@@ -4,63 +4,124 @@
 #include "math.h"
 #include "physics.h"
 
-#define TILE_TYPE_SHIFT 8
-#define TILE_TYPE_MASK	0xFF00
-#define TILE_SHAPE_MASK 0x00FF
+// Points at block 0, 0 of the collision grid, inside the border
+unsigned char* collision_grid;
+int collision_stride;
+unsigned int collision_version;
 
-unsigned short* tile_types = (unsigned short*)0x02022000;
-
-bool (*physics_code[255])(int, int, int, int, int, bool);
-bool (*collide_code[255])(int, int, int, int);
+const unsigned char* shape_profiles;
 
 extern unsigned int lvl_width, lvl_height;
-extern unsigned short* tileset_data;
 
-void load_tiletypes(unsigned short* coll_data) {
-	int readValue = *coll_data++;
-	int index	  = 0;
+void load_tile_shapes(const unsigned char* profiles) {
+	shape_profiles = profiles;
+}
+
+// The lowest start of the spans from `first` to `last`, ignoring empty spans.  Returns -1 if they're all empty
+static inline int span_min(const unsigned char* start, const unsigned char* end, int first, int last) {
+	int i, retval = BLOCK_SIZE;
 
-	while (readValue != 0xFFFF) {
-		tile_types[index++] = readValue;
+	first = (first < 0) ? 0 : first;
+	last  = (last >= BLOCK_SIZE) ? BLOCK_SIZE - 1 : last;
 
-		readValue = *coll_data++;
+	for (i = first; i <= last; ++i) {
+		if (end[i] > start[i] && start[i] < retval)
+			retval = start[i];
 	}
+
+	return (retval == BLOCK_SIZE) ? -1 : retval;
+}
+// The highest end of the spans from `first` to `last`, ignoring empty spans.  Returns -1 if they're all empty
+static inline int span_max(const unsigned char* start, const unsigned char* end, int first, int last) {
+	int i, retval = 0;
+
+	first = (first < 0) ? 0 : first;
+	last  = (last >= BLOCK_SIZE) ? BLOCK_SIZE - 1 : last;
+
+	for (i = first; i <= last; ++i) {
+		if (end[i] > start[i] && end[i] > retval)
+			retval = end[i];
+	}
+
+	return retval ? retval : -1;
+}
+// If a rectangle, relative to the block, touches the solid part of a shape
+static inline int shape_overlaps(const unsigned char* profile, int x, int y, int width, int height) {
+	int i, last = x + width - 1, bottom = y + height;
+
+	x	 = (x < 0) ? 0 : x;
+	last = (last >= BLOCK_SIZE) ? BLOCK_SIZE - 1 : last;
+
+	for (i = x; i <= last; ++i) {
+		int top = profile[PROFILE_TOP + i], bot = profile[PROFILE_BOTTOM + i];
+
+		if (bot > top && top < bottom && bot > y)
+			return 1;
+	}
+
+	return 0;
+}
+
+void reset_collision_grid(unsigned char* grid) {
+	collision_stride = lvl_width + 2;
+	collision_grid	 = grid + collision_stride + 1;
+
+	collision_version++;
 }
+int get_collision(int x, int y) {
+	x = (x < -1) ? -1 : x;
+	y = (y < -1) ? -1 : y;
+	x = (x > lvl_width) ? lvl_width : x;
+	y = (y > lvl_height) ? lvl_height : y;
 
-int get_block(int x, int y) {
-	x = (x < 0) ? 0 : x;
-	y = (y < 0) ? 0 : y;
-	x = (x >= lvl_width) ? lvl_width - 1 : x;
-	y = (y >= lvl_height) ? lvl_height - 1 : y;
+	return COLLISION_AT(x, y);
+}
+// If every block from (x1, y1) to (x2, y2) is inside the border, and can be read without clamping
+static inline int collision_unclamped(int x1, int x2, int y1, int y2) {
+	if (x1 > x2) {
+		int temp = x1;
+		x1 = x2;
+		x2 = temp;
+	}
+	if (y1 > y2) {
+		int temp = y1;
+		y1 = y2;
+		y2 = temp;
+	}
 
-	return tileset_data[x + (y * lvl_width)] & 0x7FF;
+	return x1 >= -1 && y1 >= -1 && x2 <= lvl_width && y2 <= lvl_height;
 }
 
+#ifndef ENTITY_SOA
 unsigned int entity_physics(Entity* ent, int hit_mask) {
-	if (ent->width <= 0 || ent->height <= 0) {
+	return entity_physics_at(ent - entities, hit_mask);
+}
+#endif
+HOT_CODE unsigned int entity_physics_at(unsigned int index, int hit_mask) {
+	if (ENT_WIDTH(index) <= 0 || ENT_HEIGHT(index) <= 0) {
 		return 0;
 	}
 
 	// Get the sign (-/+) of the velocity components
-	int sign_x = (ent->vel_x >> 31) | 1, sign_y = (ent->vel_y >> 31) | 1;
-	int y_is_pos = -(~(ent->vel_y) >> 31); // If y is positive, equals 1, else 0;
-	int y_is_neg = ent->vel_y >> 31;	   // If y is negative, equals -1, else 0;
-	int x_is_pos = -(~(ent->vel_x) >> 31); // If x is positive, equals 1, else 0;
-	int x_is_neg = ent->vel_x >> 31;	   // If x is negative, equals -1, else 0;
+	int sign_x = (ENT_VEL_X(index) >> 31) | 1, sign_y = (ENT_VEL_Y(index) >> 31) | 1;
+	int y_is_pos = -(~(ENT_VEL_Y(index)) >> 31); // If y is positive, equals 1, else 0;
+	int y_is_neg = ENT_VEL_Y(index) >> 31;		 // If y is negative, equals -1, else 0;
+	int x_is_pos = -(~(ENT_VEL_X(index)) >> 31); // If x is positive, equals 1, else 0;
+	int x_is_neg = ENT_VEL_X(index) >> 31;		 // If x is negative, equals -1, else 0;
 
 	// Box collision indexes - Tile values;
 	int idxX, idxY;
 
-	// int top = FIXED2INT(ent->y),
-	// 	bot = top + ent->height,
-	// 	lef = FIXED2INT(ent->x),
-	// 	rgt = lef + ent->width;
+	// int top = FIXED2INT(ENT_Y(index)),
+	// 	bot = top + ENT_HEIGHT(index),
+	// 	lef = FIXED2INT(ENT_X(index)),
+	// 	rgt = lef + ENT_WIDTH(index);
 
 	// Get the start and end of the base collisionbox
-	int y_min = FIXED2INT(ent->y) - y_is_neg * (ent->height - 1),
-		y_max = FIXED2INT(ent->y) + y_is_pos * (ent->height - 1),
-		x_min = FIXED2INT(ent->x) - x_is_neg * (ent->width - 1),
-		x_max = FIXED2INT(ent->x) + x_is_pos * (ent->width - 1);
+	int y_min = FIXED2INT(ENT_Y(index)) - y_is_neg * (ENT_HEIGHT(index) - 1),
+		y_max = FIXED2INT(ENT_Y(index)) + y_is_pos * (ENT_HEIGHT(index) - 1),
+		x_min = FIXED2INT(ENT_X(index)) - x_is_neg * (ENT_WIDTH(index) - 1),
+		x_max = FIXED2INT(ENT_X(index)) + x_is_pos * (ENT_WIDTH(index) - 1);
 
 	// Block values that were hit - flag
 	int hit_value_x = 0, hit_value_y = 0;
@@ -68,26 +129,33 @@ unsigned int entity_physics(Entity* ent, int hit_mask) {
 	int offsetX = 0xFFFF, offsetY = 0xFFFF;
 
 	int vel;
-	if (!ent->vel_x)
+	if (!ENT_VEL_X(index))
 		vel = 0;
 	else
-		vel = FIXED2INT(ent->vel_x + (sign_x * 0x7F) + 0x80 + x_is_neg);
+		vel = FIXED2INT(ENT_VEL_X(index) + (sign_x * 0x7F) + 0x80 + x_is_neg);
+
+	int unclamped = collision_unclamped(INT2BLOCK(x_min), INT2BLOCK(x_max + vel), INT2BLOCK(y_min), INT2BLOCK(y_max));
 
 	// X physics
+	// Walk down each column of the collision grid with a pointer, instead of working out each block's position
+	int step = sign_y * collision_stride;
+	const unsigned char* cell;
+
 	for (idxX = INT2BLOCK(x_min); idxX != INT2BLOCK(x_max + vel) + sign_x; idxX += sign_x) {
-		for (idxY = INT2BLOCK(y_min); idxY != INT2BLOCK(y_max) + sign_y; idxY += sign_y) {
-			int block = get_block(idxX, idxY);
-			if (!block) // If the block is air, then ignore
+		cell = &COLLISION_AT(idxX, INT2BLOCK(y_min));
+
+		for (idxY = INT2BLOCK(y_min); idxY != INT2BLOCK(y_max) + sign_y; idxY += sign_y, cell += step) {
+			int shape = unclamped ? *cell : get_collision(idxX, idxY);
+			if (!shape) // If the block is air, then ignore
 				continue;
 
-			int shape = tile_types[block - 1];						 // The actual collision shape
-			int type  = (shape & TILE_TYPE_MASK) >> TILE_TYPE_SHIFT; // the collision type (for enabling/disabling certain collisions)
-			int mask  = 1 << (type - 1);							 // The bitmask for the collision type
+			int type = COLLISION_TYPE(shape); // the collision type (for enabling/disabling certain collisions)
+			int mask = 1 << (type - 1);		  // The bitmask for the collision type
 
 			if (!type || !(mask & hit_mask)) // Ignore if block is being ignored, or
 				continue;
 
-			shape = shape & TILE_SHAPE_MASK;
+			shape = COLLISION_SHAPE(shape); // The actual collision shape
 
 			int temp_offset = 0xFFFFF;
 
@@ -95,22 +163,28 @@ unsigned int entity_physics(Entity* ent, int hit_mask) {
 			switch (shape) {
 
 				case 0:
-					temp_offset = (BLOCK2FIXED(idxX - x_is_neg) - INT2FIXED(ent->width * x_is_pos)) - ent->x;
+					temp_offset = (BLOCK2FIXED(idxX - x_is_neg) - INT2FIXED(ENT_WIDTH(index) * x_is_pos)) - ENT_X(index);
 					break;
-				default:
-					if (physics_code[shape - 1]) {
+				default: {
+					if (!shape_profiles)
+						continue;
 
-						temp_offset = physics_code[shape - 1](FIXED2INT(ent->x) - BLOCK2INT(idxX), FIXED2INT(ent->y) - BLOCK2INT(idxY), ent->width, ent->height, vel, false);
+					// Find the closest solid edge in the rows the entity covers
+					const unsigned char* profile = SHAPE_PROFILE(shape);
+					int top						 = FIXED2INT(ENT_Y(index)) - BLOCK2INT(idxY);
+					int edge					 = x_is_pos ? span_min(profile + PROFILE_LEFT, profile + PROFILE_RIGHT, top, top + ENT_HEIGHT(index) - 1)
+															: span_max(profile + PROFILE_LEFT, profile + PROFILE_RIGHT, top, top + ENT_HEIGHT(index) - 1);
 
-						if (temp_offset >= 0) {
-							continue;
-							temp_offset = BLOCK2FIXED(idxX - x_is_neg) - INT2FIXED(ent->width * x_is_pos) - ent->x;
-						} else {
-							continue;
-						}
-					} else {
+					if (edge < 0)
 						continue;
-					}
+
+					temp_offset = BLOCK2FIXED(idxX) + INT2FIXED(edge) - INT2FIXED(ENT_WIDTH(index) * x_is_pos) - ENT_X(index);
+
+					// The solid part is further away than the entity is moving this frame
+					if (temp_offset * sign_x > ENT_VEL_X(index) * sign_x)
+						continue;
+					break;
+				}
 			}
 
 			if (INT_ABS(temp_offset) < INT_ABS(offsetX)) // If new movement is smaller, set collision data.
@@ -124,39 +198,43 @@ unsigned int entity_physics(Entity* ent, int hit_mask) {
 		}
 
 		if (hit_value_x) {
-			ent->x += offsetX;
+			ENT_X(index) += offsetX;
 
-			if (ent->vel_x != 0 && sign_x == INT_SIGN((BLOCK2FIXED(idxX) + 0x400) - (ent->x + (ent->width >> 1))))
-				ent->vel_x = 0;
+			if (ENT_VEL_X(index) != 0 && sign_x == INT_SIGN((BLOCK2FIXED(idxX) + 0x400) - (ENT_X(index) + (ENT_WIDTH(index) >> 1))))
+				ENT_VEL_X(index) = 0;
 			else
 				hit_value_x = 0;
 			break;
 		}
 	}
-	ent->x += ent->vel_x * !(hit_value_x & hit_mask);
+	ENT_X(index) += ENT_VEL_X(index) * !(hit_value_x & hit_mask);
 
-	x_min = FIXED2INT(ent->x) - x_is_neg * (ent->width - 1);
-	x_max = FIXED2INT(ent->x) + x_is_pos * (ent->width - 1);
-	if (!ent->vel_y)
+	x_min = FIXED2INT(ENT_X(index)) - x_is_neg * (ENT_WIDTH(index) - 1);
+	x_max = FIXED2INT(ENT_X(index)) + x_is_pos * (ENT_WIDTH(index) - 1);
+	if (!ENT_VEL_Y(index))
 		vel = 0;
 	else
-		vel = FIXED2INT(ent->vel_y + (sign_y * 0x7F) + 0x80 + y_is_neg);
+		vel = FIXED2INT(ENT_VEL_Y(index) + (sign_y * 0x7F) + 0x80 + y_is_neg);
+
+	unclamped = collision_unclamped(INT2BLOCK(x_min), INT2BLOCK(x_max), INT2BLOCK(y_min), INT2BLOCK(y_max + vel));
 
 	// Y Physics
+	// Same as above, along each row
 	for (idxY = INT2BLOCK(y_min); idxY != INT2BLOCK(y_max + vel) + sign_y; idxY += sign_y) {
-		for (idxX = INT2BLOCK(x_min); idxX != INT2BLOCK(x_max) + sign_x; idxX += sign_x) {
-			int block = get_block(idxX, idxY);
-			if (!block)
+		cell = &COLLISION_AT(INT2BLOCK(x_min), idxY);
+
+		for (idxX = INT2BLOCK(x_min); idxX != INT2BLOCK(x_max) + sign_x; idxX += sign_x, cell += sign_x) {
+			int shape = unclamped ? *cell : get_collision(idxX, idxY);
+			if (!shape)
 				continue;
 
-			int shape = tile_types[block - 1];
-			int type  = (shape & TILE_TYPE_MASK) >> TILE_TYPE_SHIFT;
-			int mask  = 1 << (type - 1);
+			int type = COLLISION_TYPE(shape);
+			int mask = 1 << (type - 1);
 
 			if (!type || !(mask & hit_mask)) // If the block is 0 or if the block is not solid, ignore
 				continue;
 
-			shape = shape & TILE_SHAPE_MASK;
+			shape = COLLISION_SHAPE(shape);
 
 			int temp_offset = 0xFFFFF;
 
@@ -164,22 +242,29 @@ unsigned int entity_physics(Entity* ent, int hit_mask) {
 			switch (shape) {
 
 				case 0:
-					temp_offset = BLOCK2FIXED(idxY - y_is_neg) - INT2FIXED(ent->height * y_is_pos) - ent->y;
+					temp_offset = BLOCK2FIXED(idxY - y_is_neg) - INT2FIXED(ENT_HEIGHT(index) * y_is_pos) - ENT_Y(index);
 					break;
 
-				default:
-					if (physics_code[shape - 1]) {
+				default: {
+					if (!shape_profiles)
+						continue;
 
-						temp_offset = physics_code[shape - 1](FIXED2INT(ent->x) - BLOCK2INT(idxX), FIXED2INT(ent->y) - BLOCK2INT(idxY), ent->width, ent->height, vel, true);
+					// Find the closest solid edge in the columns the entity covers
+					const unsigned char* profile = SHAPE_PROFILE(shape);
+					int left					 = FIXED2INT(ENT_X(index)) - BLOCK2INT(idxX);
+					int edge					 = y_is_pos ? span_min(profile + PROFILE_TOP, profile + PROFILE_BOTTOM, left, left + ENT_WIDTH(index) - 1)
+															: span_max(profile + PROFILE_TOP, profile + PROFILE_BOTTOM, left, left + ENT_WIDTH(index) - 1);
 
-						if (temp_offset >= 0) {
-							temp_offset = BLOCK2FIXED(idxY - y_is_neg) - INT2FIXED(ent->height * y_is_pos) - ent->y;
-						} else {
-							continue;
-						}
-					} else {
+					if (edge < 0)
 						continue;
-					}
+
+					temp_offset = BLOCK2FIXED(idxY) + INT2FIXED(edge) - INT2FIXED(ENT_HEIGHT(index) * y_is_pos) - ENT_Y(index);
+
+					// The solid part is further away than the entity is moving this frame
+					if (temp_offset * sign_y > ENT_VEL_Y(index) * sign_y)
+						continue;
+					break;
+				}
 			}
 
 			if (INT_ABS(temp_offset) < INT_ABS(offsetY)) // If new movement is smaller, set collision data.
@@ -193,20 +278,20 @@ unsigned int entity_physics(Entity* ent, int hit_mask) {
 		}
 
 		if (hit_value_y) {
-			ent->y += offsetY;
+			ENT_Y(index) += offsetY;
 
-			if (ent->vel_y != 0 && sign_y == INT_SIGN((BLOCK2FIXED(idxY) + 0x400) - (ent->y + (ent->height >> 1))))
-				ent->vel_y = 0;
+			if (ENT_VEL_Y(index) != 0 && sign_y == INT_SIGN((BLOCK2FIXED(idxY) + 0x400) - (ENT_Y(index) + (ENT_HEIGHT(index) >> 1))))
+				ENT_VEL_Y(index) = 0;
 			else
 				hit_value_y = 0;
 			break;
 		}
 	}
-	ent->y += ent->vel_y * !(hit_value_y & hit_mask);
+	ENT_Y(index) += ENT_VEL_Y(index) * !(hit_value_y & hit_mask);
 
 	return (hit_value_x << 16) | hit_value_y;
 }
-unsigned int collide_rect(int x, int y, int width, int height, int hit_mask) {
+HOT_CODE unsigned int collide_rect(int x, int y, int width, int height, int hit_mask) {
 	int y_min = y,
 		y_max = y_min + height - 1;
 
@@ -218,21 +303,26 @@ unsigned int collide_rect(int x, int y, int width, int height, int hit_mask) {
 	int hitValue = 0;
 	int xCoor, yCoor;
 
+	int unclamped = collision_unclamped(INT2BLOCK(x_min), INT2BLOCK(x_max), INT2BLOCK(y_min), INT2BLOCK(y_max));
+
+	const unsigned char* cell;
+
 	for (xCoor = INT2BLOCK(x_min); xCoor <= INT2BLOCK(x_max); ++xCoor) {
-		for (yCoor = INT2BLOCK(y_min); yCoor <= INT2BLOCK(y_max); ++yCoor) {
+		cell = &COLLISION_AT(xCoor, INT2BLOCK(y_min));
 
-			int shape = get_block(xCoor, yCoor);
+		for (yCoor = INT2BLOCK(y_min); yCoor <= INT2BLOCK(y_max); ++yCoor, cell += collision_stride) {
+
+			int shape = unclamped ? *cell : get_collision(xCoor, yCoor);
 			if (!shape)
 				continue;
 
-			shape	 = tile_types[shape - 1];
-			int type = (shape & TILE_TYPE_MASK) >> TILE_TYPE_SHIFT;
+			int type = COLLISION_TYPE(shape);
 			int mask = 1 << (type - 1);
 
 			if (!type || !(mask & hit_mask)) // If the block is 0 or if the block is not solid, ignore
 				continue;
 
-			shape = shape & TILE_SHAPE_MASK;
+			shape = COLLISION_SHAPE(shape);
 
 			switch (shape) {
 
@@ -241,7 +331,7 @@ unsigned int collide_rect(int x, int y, int width, int height, int hit_mask) {
 					break;
 
 				default:
-					if (collide_code[shape - 1] && collide_code[shape - 1](x - BLOCK2INT(xCoor), y - BLOCK2INT(yCoor), width, height)) {
+					if (shape_profiles && shape_overlaps(SHAPE_PROFILE(shape), x - BLOCK2INT(xCoor), y - BLOCK2INT(yCoor), width, height)) {
 						hitValue |= mask;
 					}
 
@@ -252,34 +342,93 @@ unsigned int collide_rect(int x, int y, int width, int height, int hit_mask) {
 
 	return hitValue;
 }
-int collide_entity(unsigned int index) {
-	int i = 0;
+// ---- Batched physics ----
+
+// Everything physics depends on from each entity's last step while resting.  If none of it has changed, and the
+// entity still isn't moving, another step would do nothing
+int rest_x[ENTITY_LIMIT], rest_y[ENTITY_LIMIT];
+unsigned int rest_size[ENTITY_LIMIT], rest_version[ENTITY_LIMIT];
+unsigned short rest_mask[ENTITY_LIMIT];
+
+void move_entity_rest(unsigned int dst, unsigned int src) {
+	rest_x[dst]		  = rest_x[src];
+	rest_y[dst]		  = rest_y[src];
+	rest_size[dst]	  = rest_size[src];
+	rest_version[dst] = rest_version[src];
+	rest_mask[dst]	  = rest_mask[src];
+}
 
-	Entity* this = &entities[index], *other;
+HOT_CODE void physics_step_all(PhysicsContactFunc on_contact) {
+	unsigned short list[ENTITY_LIMIT];
+	int i, count = 0;
 
-	int id_LX = FIXED2INT(this->x);
-	int id_LY = FIXED2INT(this->y);
-	int id_RX = id_LX + this->width - 1;
-	int id_RY = id_LY + this->height - 1;
-	int iter_LX, iter_LY, iter_RX, iter_RY;
+	// Gather every entity that needs physics first, so contact callbacks can't change which entities get stepped
+	for (i = 0; i < active_entities.count; ++i) {
+		int index = active_entities.items[i];
+
+		if (!ENT_FLAG(COLLIDE, index))
+			continue;
 
-	for (; i < ENTITY_LIMIT; ++i) {
-		if (i == index)
+		if (!ENT_VEL_X(index) && !ENT_VEL_Y(index) && ENT_X(index) == rest_x[index] && ENT_Y(index) == rest_y[index] &&
+			rest_size[index] == ((ENT_WIDTH(index) << 16) | ENT_HEIGHT(index)) &&
+			rest_version[index] == collision_version && rest_mask[index] == ENT_HIT_MASK(index))
 			continue;
-		if (!ENT_FLAG(ACTIVE, i) || !ENT_FLAG(DETECT, i))
+
+		list[count++] = index;
+	}
+
+	for (i = 0; i < count; ++i) {
+		int index = list[i];
+
+		// An earlier contact may have unloaded it
+		if (!ENT_IN_LIST(active_entities, index))
 			continue;
 
-		other = &entities[i];
+		int x = ENT_X(index), y = ENT_Y(index);
+		int still = !ENT_VEL_X(index) && !ENT_VEL_Y(index);
+
+		unsigned int hit = entity_physics_at(index, ENT_HIT_MASK(index));
+
+		// Only counts as resting once a step with no velocity doesn't push it anywhere
+		if (still && x == ENT_X(index) && y == ENT_Y(index)) {
+			rest_x[index]		= x;
+			rest_y[index]		= y;
+			rest_size[index]	= (ENT_WIDTH(index) << 16) | ENT_HEIGHT(index);
+			rest_version[index] = collision_version;
+			rest_mask[index]	= ENT_HIT_MASK(index);
+		} else {
+			rest_version[index] = collision_version - 1;
+		}
+
+		if (hit && on_contact)
+			on_contact(index, hit);
+	}
+}
+
+int collide_entity(unsigned int index) {
+	int i, other_index;
+
+	int id_LX = FIXED2INT(ENT_X(index));
+	int id_LY = FIXED2INT(ENT_Y(index));
+	int id_RX = id_LX + ENT_WIDTH(index) - 1;
+	int id_RY = id_LY + ENT_HEIGHT(index) - 1;
+	int iter_LX, iter_LY, iter_RX, iter_RY;
+
+	for (i = 0; i < detect_entities.count; ++i) {
+		other_index = detect_entities.items[i];
+
+		if (other_index == index)
+			continue;
 
-		iter_LX = FIXED2INT(other->x);
-		iter_LY = FIXED2INT(other->y);
-		iter_RX = iter_LX + other->width - 1;
-		iter_RY = iter_LY + other->height - 1;
+		iter_LX = FIXED2INT(ENT_X(other_index));
+		iter_LY = FIXED2INT(ENT_Y(other_index));
+		iter_RX = iter_LX + ENT_WIDTH(other_index) - 1;
+		iter_RY = iter_LY + ENT_HEIGHT(other_index) - 1;
 
 		if (id_RX < iter_LX || iter_RX < id_LX || id_RY < iter_LY || iter_RY < id_LY)
 			continue;
 
-		return i;
+		return other_index;
 	}
 	return -1;
 }
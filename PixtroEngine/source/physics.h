@@ -4,8 +4,56 @@
 #include "entities.h"
 #include "tonc_vscode.h"
 
-extern unsigned short* tile_types;
+// The collision of every block in the level, one byte each with the type in the top 4 bits and the shape in the bottom 4.
+// The compiler adds a one block border around the level, copied from the edges, so blocks from -1 to the level's size
+// can be read without clamping.  Levels kept in the level cache have their grid next to their tiles, and everything else
+// uses COLLISION_GRID
+#define COLLISION_GRID ((unsigned char*)0x0203C000)
 
+#define COLLISION_AT(x, y)	  (collision_grid[(x) + ((y) * collision_stride)])
+#define COLLISION_TYPE(c)	  ((c) >> 4)
+#define COLLISION_SHAPE(c)	  ((c) & 0xF)
+#define COLLISION_VALUE(t, s) (((t) << 4) | (s))
+
+// Collision shapes other than full blocks (shapes 1 to 15), generated by the compiler from the visual pack's "Shapes" and
+// loaded with the tileset.  Each shape has BLOCK_SIZE bytes for each of: the top and bottom of the solid part of each
+// column, then the left and right of the solid part of each row.  Empty columns and rows have both set to 0.
+// Slopes have no rows, so they don't stop entities moving sideways, and instead push entities up or down onto them
+#define SHAPE_COUNT		   15
+#define SHAPE_PROFILE_SIZE (BLOCK_SIZE * 4)
+#define SHAPE_PROFILE(s)   (shape_profiles + (((s)-1) * SHAPE_PROFILE_SIZE))
+
+#define PROFILE_TOP	   0
+#define PROFILE_BOTTOM BLOCK_SIZE
+#define PROFILE_LEFT   (BLOCK_SIZE * 2)
+#define PROFILE_RIGHT  (BLOCK_SIZE * 3)
+
+extern const unsigned char* shape_profiles;
+
+void load_tile_shapes(const unsigned char* profiles);
+
+extern unsigned char* collision_grid;
+extern int collision_stride;
+// Changes whenever the collision grid does.  Increment it after editing the grid by hand, so resting entities get rechecked
+extern unsigned int collision_version;
+
+// Set up collision_grid for the level that's loading, with `grid` being the start of its border
+void reset_collision_grid(unsigned char* grid);
+// The collision of a block, clamped to the level's edges
+int get_collision(int x, int y);
+
+extern HOT_CODE unsigned int entity_physics_at(unsigned int index, int hit_mask);
+#ifndef ENTITY_SOA
 extern unsigned int entity_physics(Entity* ent, int hit_mask);
-extern unsigned int collide_rect(int x, int y, int width, int height, int hit_mask);
+#endif
+extern HOT_CODE unsigned int collide_rect(int x, int y, int width, int height, int hit_mask);
+
+// Called by physics_step_all for every entity that hit something.  `hits` is the same as entity_physics' return value
+typedef void (*PhysicsContactFunc)(unsigned int index, unsigned int hits);
+
+// Run physics on every active entity with ENT_COLLIDE_FLAG, using each entity's ENT_HIT_MASK.  Gives the same results as
+// calling entity_physics on each of them, but skips entities that are resting.  `on_contact` can be NULL
+extern HOT_CODE void physics_step_all(PhysicsContactFunc on_contact);
+// Copy whether an entity is resting into another slot.  Done by move_entity
+void move_entity_rest(unsigned int dst, unsigned int src);
 extern int collide_entity(unsigned int index);
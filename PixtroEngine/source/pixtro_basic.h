@@ -6,5 +6,9 @@
 #include "physics.h"
 #include "particles.h"
 #include "core.h"
+#include "broadphase.h"
+#include "dma_queue.h"
 #include "input.h"
-#include "math.h"
\ No newline at end of file
+#include "math.h"
+#include "palette.h"
+#include "profiler.h"
\ No newline at end of file
@@ -0,0 +1,83 @@
+#include "profiler.h"
+
+#include "core.h"
+
+void cycle_counter_start() {
+	REG_TM2CNT = 0;
+	REG_TM3CNT = 0;
+	REG_TM2D   = 0;
+	REG_TM3D   = 0;
+
+	// Timer 3 counts up every time timer 2 overflows
+	REG_TM3CNT = TM_CASCADE | TM_ENABLE;
+	REG_TM2CNT = TM_FREQ_1 | TM_ENABLE;
+}
+
+#ifdef __DEBUG__
+
+ProfileData profile_data;
+unsigned int profile_mark, profile_zone_start[PROFILE_ZONES];
+
+void profile_init() {
+	profile_data.index	  = 0;
+	profile_data.length	  = PROFILE_FRAMES;
+	profile_data.recorded = 0;
+
+	profile_data.worst.total = 0;
+}
+
+void profile_start_frame() {
+	int i;
+
+	profile_data.index++;
+	if (profile_data.index >= PROFILE_FRAMES)
+		profile_data.index = 0;
+
+	if (profile_data.recorded < PROFILE_FRAMES)
+		profile_data.recorded++;
+
+	ProfileFrame* frame = &PROFILE_CURRENT;
+
+	frame->frame = game_life;
+	frame->total = 0;
+
+	for (i = 0; i < PROFILE_PHASE_COUNT; ++i) {
+		frame->phase_cycles[i] = 0;
+		frame->phase_vcount[i] = 0;
+	}
+	for (i = 0; i < PROFILE_ZONES; ++i) {
+		frame->zone_cycles[i] = 0;
+	}
+	for (i = 0; i < 32; ++i) {
+		frame->type_cycles[i] = 0;
+	}
+
+	profile_mark = cycle_count();
+}
+
+void profile_phase(int phase) {
+	unsigned int now = cycle_count();
+
+	PROFILE_CURRENT.phase_cycles[phase] += now - profile_mark;
+	PROFILE_CURRENT.phase_vcount[phase] = REG_VCOUNT;
+
+	profile_mark = now;
+}
+
+void profile_end_frame() {
+	int i;
+	unsigned int total = 0;
+
+	ProfileFrame* frame = &PROFILE_CURRENT;
+
+	for (i = 0; i < PROFILE_PHASE_COUNT; ++i) {
+		if (i != PROFILE_IDLE)
+			total += frame->phase_cycles[i];
+	}
+	frame->total = total;
+
+	if (total > profile_data.worst.total)
+		profile_data.worst = *frame;
+}
+
+#endif
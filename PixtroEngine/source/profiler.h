@@ -0,0 +1,123 @@
+#pragma once
+
+#include "engine.h"
+#include "tonc_vscode.h"
+
+// ---- Cycle Counter ----
+// Timers 2 and 3 are cascaded into a 32 bit counter that runs at the cpu's clock speed.
+// A full frame is 280,896 cycles, 1,232 cycles per scanline.
+
+#define CYCLES_PER_FRAME	280896
+#define CYCLES_PER_SCANLINE 1232
+
+void cycle_counter_start();
+
+INLINE unsigned int cycle_count() {
+	unsigned int high = REG_TM3D, low = REG_TM2D;
+
+	// If the low timer overflowed between reads, read both again
+	if (high != REG_TM3D) {
+		high = REG_TM3D;
+		low	 = REG_TM2D;
+	}
+
+	return (high << 16) | low;
+}
+
+// ---- Profiler ----
+// Debug builds record how many cycles each phase of the engine takes every frame into `profile_data`.
+// The editor reads it from there to show per-frame breakdowns and the worst frame seen.
+
+// The amount of frames kept in the ring buffer
+#ifndef PROFILE_FRAMES
+#define PROFILE_FRAMES 8
+#endif
+
+// The amount of user defined zones
+#define PROFILE_ZONES 8
+
+typedef enum {
+	PROFILE_INPUTS,
+	PROFILE_ENTITY_UPDATE,
+	PROFILE_CUSTOM_UPDATE,
+	PROFILE_ENGINE_UPDATE, // Fading, async loading, and everything else at the end of the update
+	PROFILE_IDLE,		   // Audio, and waiting for VBlank
+	PROFILE_MOVE_CAM,
+	PROFILE_BEGIN_DRAWING,
+	PROFILE_PARTICLES,
+	PROFILE_ENTITY_RENDER,
+	PROFILE_CUSTOM_RENDER,
+	PROFILE_END_DRAWING,
+	PROFILE_FADE,
+
+	PROFILE_PHASE_COUNT,
+} ProfilePhase;
+
+// Keep in sync with GameCommunicator.ProfileFrame in the editor
+typedef struct
+{
+	// The game_life value of this frame
+	unsigned int frame;
+	// Cycles taken by every phase except idling
+	unsigned int total;
+
+	unsigned int phase_cycles[PROFILE_PHASE_COUNT];
+	unsigned int zone_cycles[PROFILE_ZONES];
+	// Cycles taken by the update function of each entity type
+	unsigned int type_cycles[32];
+	// The scanline when each phase finished
+	unsigned char phase_vcount[PROFILE_PHASE_COUNT];
+} ALIGN4 ProfileFrame;
+
+// Keep in sync with GameCommunicator.GetProfileFrame in the editor
+typedef struct
+{
+	// Index of the newest frame in `frames`
+	unsigned int index;
+	// Always equals PROFILE_FRAMES.  Lets the editor know how big the ring buffer is
+	unsigned int length;
+	// Frames recorded so far, up to PROFILE_FRAMES.  Frames in the ring buffer past this haven't been filled in yet
+	unsigned int recorded;
+
+	ProfileFrame worst;
+	ProfileFrame frames[PROFILE_FRAMES];
+} ALIGN4 ProfileData;
+
+#ifdef __DEBUG__
+
+extern ProfileData profile_data;
+extern unsigned int profile_mark, profile_zone_start[PROFILE_ZONES];
+
+#define PROFILE_CURRENT (profile_data.frames[profile_data.index])
+
+void profile_init();
+void profile_start_frame();
+void profile_end_frame();
+void profile_phase(int phase);
+
+// Start counting cycles from now without giving the time since the last phase to anything
+#define PROFILE_SKIP() profile_mark = cycle_count()
+// End the current phase, giving it all the cycles since the last phase ended
+#define PROFILE_PHASE(name) profile_phase(PROFILE_##name)
+
+// User zones can be put around any code.  Zones can be used more than once per frame, and add up
+#define PROFILE_ZONE_BEGIN(zone) profile_zone_start[zone] = cycle_count()
+#define PROFILE_ZONE_END(zone)	 PROFILE_CURRENT.zone_cycles[zone] += cycle_count() - profile_zone_start[zone]
+
+#define PROFILE_TYPE_BEGIN()	unsigned int profile_type_start = cycle_count()
+#define PROFILE_TYPE_END(type)	PROFILE_CURRENT.type_cycles[type] += cycle_count() - profile_type_start
+
+#else
+
+#define profile_init()
+#define profile_start_frame()
+#define profile_end_frame()
+
+#define PROFILE_SKIP()
+#define PROFILE_PHASE(name)
+#define PROFILE_ZONE_BEGIN(zone)
+#define PROFILE_ZONE_END(zone)
+#define PROFILE_TYPE_BEGIN()
+#define PROFILE_TYPE_END(type)
+
+#endif
@@ -0,0 +1,287 @@
+#include "scanline.h"
+#include <string.h>
+
+#include "graphics.h"
+#include "math.h"
+#include "tonc_vscode.h"
+
+#ifdef SCANLINE_EFFECTS
+
+// Each line of a table has the x and y scroll of the layers from the first to the last one with offsets, in the same
+// order as the background registers, so HBlank DMA only copies over the registers it needs to.  Layers outside that
+// range keep the scroll written along with OAM
+#define LINE_WORDS 4
+
+// Offset given to bands that haven't been set yet, so they always get updated the first time
+#define NO_BAND_OFFSET 0x7FFF
+
+typedef struct {
+	unsigned char layer, top, bottom;
+	short parallax_x, parallax_y;
+	// The offset the band's lines were last set to
+	short x, y;
+} ScanlineBand;
+
+// Two tables, so one can be built while the other is being drawn.  There's an extra line, since the HBlank after the
+// last line on screen still copies one more.  Lines are packed together, `table_span` words each
+EWRAM_BSS ALIGN4 unsigned int scanline_table[2][(SCREEN_LINES + 1) * LINE_WORDS];
+int scanline_front, scanline_enabled;
+
+// The first layer and amount of layers each table was built with
+unsigned char table_first[2], table_span[2];
+
+// What the last update left waiting to be committed
+#define SCANLINE_OFF   1
+#define SCANLINE_BUILT 2
+volatile char scanline_ready;
+
+// The offset of every line of each layer, as x and y pairs
+EWRAM_BSS short scanline_offset[4][SCREEN_LINES][2];
+
+// Lines of each layer that need rebuilding in each table, from top up to bottom
+unsigned char dirty_top[2][4], dirty_bottom[2][4];
+
+unsigned int scanline_layers;
+int base_x[4], base_y[4];
+
+ScanlineBand scanline_bands[SCANLINE_BAND_LIMIT];
+
+extern int cam_x, cam_y;
+
+// The layers from the first one with offsets to the last one, including any without offsets between them
+static int layer_range(int* first) {
+	int l = 0, last = 3;
+
+	while (l < 4 && !(scanline_layers & (1 << l)))
+		++l;
+	while (last > l && !(scanline_layers & (1 << last)))
+		--last;
+
+	*first = l;
+	return last - l + 1;
+}
+
+// Lines changed in one table also need changing in the other, once it's that table's turn to be built
+static void mark_lines(int layer, int top, int bottom) {
+	int i;
+
+	for (i = 0; i < 2; ++i) {
+		if (dirty_top[i][layer] >= dirty_bottom[i][layer]) {
+			dirty_top[i][layer]	   = top;
+			dirty_bottom[i][layer] = bottom;
+			continue;
+		}
+
+		if (top < dirty_top[i][layer])
+			dirty_top[i][layer] = top;
+		if (bottom > dirty_bottom[i][layer])
+			dirty_bottom[i][layer] = bottom;
+	}
+}
+
+// Start using a layer.  When nothing was using the tables, every line of every layer is out of date
+static void enable_layer(int layer) {
+	int l;
+
+	if (!scanline_layers) {
+		for (l = 0; l < 4; ++l)
+			mark_lines(l, 0, SCREEN_LINES);
+	}
+
+	scanline_layers |= 1 << layer;
+}
+
+void set_scanline_offset(int layer, int top, int bottom, int x, int y) {
+	if (top < 0)
+		top = 0;
+	if (bottom > SCREEN_LINES)
+		bottom = SCREEN_LINES;
+	if (top >= bottom)
+		return;
+
+	int line;
+
+	for (line = top; line < bottom; ++line) {
+		scanline_offset[layer][line][0] = x;
+		scanline_offset[layer][line][1] = y;
+	}
+
+	enable_layer(layer);
+	mark_lines(layer, top, bottom);
+}
+void set_scanline_band(int layer, int top, int bottom, int parallax_x, int parallax_y) {
+	// Foreground layers only stream in the tiles around the camera, so a band scrolling at another speed would show
+	// tiles that aren't loaded
+	if (LAYER_GET_TYPE(layers[layer]) == LStyle_FG)
+		return;
+
+	if (top < 0)
+		top = 0;
+	if (bottom > SCREEN_LINES)
+		bottom = SCREEN_LINES;
+	if (top >= bottom)
+		return;
+
+	ScanlineBand* band = NULL;
+	int i;
+
+	for (i = 0; i < SCANLINE_BAND_LIMIT; ++i) {
+		ScanlineBand* check = &scanline_bands[i];
+
+		if (check->bottom > check->top && check->layer == layer && check->top == top) {
+			band = check;
+			break;
+		}
+		if (!band && check->bottom <= check->top)
+			band = check;
+	}
+
+	if (!band)
+		return;
+
+	// Lines the band used to cover go back to normal
+	if (band->bottom > bottom && band->layer == layer && band->top == top)
+		set_scanline_offset(layer, bottom, band->bottom, 0, 0);
+
+	band->layer		 = layer;
+	band->top		 = top;
+	band->bottom	 = bottom;
+	band->parallax_x = parallax_x;
+	band->parallax_y = parallax_y;
+	band->x			 = NO_BAND_OFFSET;
+	band->y			 = NO_BAND_OFFSET;
+
+	enable_layer(layer);
+}
+void clear_scanlines(int layer) {
+	int i;
+
+	for (i = 0; i < SCANLINE_BAND_LIMIT; ++i) {
+		if (scanline_bands[i].layer == layer)
+			scanline_bands[i].bottom = 0;
+	}
+
+	memset(scanline_offset[layer], 0, sizeof(scanline_offset[layer]));
+
+	mark_lines(layer, 0, SCREEN_LINES);
+	scanline_layers &= ~(1 << layer);
+}
+
+void scanline_scroll(int layer, int x, int y) {
+	if (x == base_x[layer] && y == base_y[layer])
+		return;
+
+	base_x[layer] = x;
+	base_y[layer] = y;
+
+	// Layers outside the table only need their register, which is set along with OAM
+	int first, span = layer_range(&first);
+
+	if (layer >= first && layer < first + span)
+		mark_lines(layer, 0, SCREEN_LINES);
+}
+
+HOT_CODE void update_scanlines() {
+	int i, l, line;
+
+	// With no offsets anywhere, the scroll set along with OAM is used for the whole screen
+	if (!scanline_layers) {
+		scanline_ready = SCANLINE_OFF;
+		return;
+	}
+
+	// Top left of the screen
+	int left = cam_x - 120, top = cam_y - 80;
+
+	for (i = 0; i < SCANLINE_BAND_LIMIT; ++i) {
+		ScanlineBand* band = &scanline_bands[i];
+
+		if (band->bottom <= band->top)
+			continue;
+
+		int x = FIXED_MULT(left, band->parallax_x) - base_x[band->layer],
+			y = FIXED_MULT(top, band->parallax_y) - base_y[band->layer];
+
+		if (x == band->x && y == band->y)
+			continue;
+
+		band->x = x;
+		band->y = y;
+
+		short* offset = scanline_offset[band->layer][band->top];
+
+		for (line = band->top; line < band->bottom; ++line, offset += 2) {
+			offset[0] = x;
+			offset[1] = y;
+		}
+
+		mark_lines(band->layer, band->top, band->bottom);
+	}
+
+	int back = scanline_front ^ 1;
+	int range_first, span = layer_range(&range_first);
+
+	// The table was last built with other layers, so every line of it is laid out differently
+	if (table_first[back] != range_first || table_span[back] != span) {
+		table_first[back] = range_first;
+		table_span[back]  = span;
+
+		for (l = range_first; l < range_first + span; ++l) {
+			dirty_top[back][l]	  = 0;
+			dirty_bottom[back][l] = SCREEN_LINES;
+		}
+	}
+
+	for (l = range_first; l < range_first + span; ++l) {
+		int first = dirty_top[back][l], last = dirty_bottom[back][l];
+
+		if (first >= last)
+			continue;
+
+		unsigned int* dst = &scanline_table[back][first * span + l - range_first];
+		short* offset	  = scanline_offset[l][first];
+		int x = base_x[l], y = base_y[l];
+
+		for (line = first; line < last; ++line, dst += span, offset += 2)
+			*dst = ((x + offset[0]) & 0xFFFF) | ((y + offset[1]) << 16);
+
+		dirty_top[back][l]	  = 0;
+		dirty_bottom[back][l] = 0;
+	}
+
+	scanline_ready = SCANLINE_BUILT;
+}
+// Start using the table built this frame.  Done when OAM is committed, so the sprites and scroll change together
+void scanline_commit() {
+	if (!scanline_ready)
+		return;
+
+	scanline_enabled = scanline_ready == SCANLINE_BUILT;
+
+	if (scanline_enabled)
+		scanline_front ^= 1;
+
+	scanline_ready = 0;
+}
+
+// Set the scroll of the first line, and have DMA set each line after it in the HBlank before it's drawn.  Only the
+// registers of the layers in the table are touched
+void scanline_vblank() {
+	REG_DMA0CNT = 0;
+
+	if (!scanline_enabled)
+		return;
+
+	const unsigned int* table = scanline_table[scanline_front];
+	int span = table_span[scanline_front], i;
+	vu32* regs = (vu32*)&REG_BG0HOFS + table_first[scanline_front];
+
+	for (i = 0; i < span; ++i)
+		regs[i] = table[i];
+
+	REG_DMA0SAD = (unsigned int)&table[span];
+	REG_DMA0DAD = (unsigned int)regs;
+	REG_DMA0CNT = DMA_HDMA | DMA_32 | span;
+}
+
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "core.h"
+
+// ---- Scanline effects ----
+//
+// Only used when SCANLINE_EFFECTS is defined in engine.h.
+// Each layer can be scrolled by a different amount on every line of the screen, on top of its normal scroll.  The
+// scroll of every line is built into a table once a frame, and HBlank DMA copies each line into the background
+// registers as the screen is drawn.  DMA channel 0 is used while any layer has offsets.
+// The table and DMA only cover the layers from the first with offsets to the last, and the rest are scrolled normally.
+// Changing offsets or bands only rebuilds the lines they cover, but all 160 lines of a layer in the table are rebuilt
+// whenever its normal scroll changes, since every line moves with it.  Keep offsets on as few layers as possible, and
+// next to each other: offsets on layers 1 and 2 build half the table that offsets on layers 0 and 3 do.
+// Foreground layers only have the tiles around the screen loaded in, so offsets on them should stay small
+
+#define SCREEN_LINES 160
+
+// The max amount of parallax bands, between every layer
+#ifndef SCANLINE_BAND_LIMIT
+#define SCANLINE_BAND_LIMIT 8
+#endif
+
+// Layers that have any offsets or bands
+extern unsigned int scanline_layers;
+
+// Move lines `top` up to `bottom` of a layer by a fixed amount of pixels
+void set_scanline_offset(int layer, int top, int bottom, int x, int y);
+// Make lines `top` up to `bottom` of a layer scroll at their own speed, where 0x100 moves with the camera.
+// Lets one layer have multiple depths, like clouds moving slower than the hills under them.  Setting a band with the
+// same layer and top line again changes that band.  Only for background layers, and does nothing on foreground ones
+void set_scanline_band(int layer, int top, int bottom, int parallax_x, int parallax_y);
+// Remove every offset and band from a layer
+void clear_scanlines(int layer);
+
+// Set the normal scroll of a layer.  Done by the camera.  Marks every line of the layer to be rebuilt if it changed
+// and is in the table
+void scanline_scroll(int layer, int x, int y);
+// Rebuild the lines that were marked, right after the camera has moved.  They're shown once the frame's sprites are
+void update_scanlines();
+void scanline_commit();
+void scanline_vblank();
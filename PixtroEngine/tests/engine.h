@@ -0,0 +1,18 @@
+#pragma once
+
+// Stand in for a game's engine.h, so engine code that doesn't touch the hardware can be built and tested on a PC
+
+#define LARGE_TILES
+
+#define HOT_CODE
+
+#define ENTITY_LIMIT 64
+
+// The parts of tonc the engine's headers use, for builds that skip the tonc headers with -D__INTELLISENSE_H__
+typedef unsigned int u32;
+
+#define INLINE static inline
+#define ALIGN4 __attribute__((aligned(4)))
+
+#define KEY_MASK 0x03FF
+extern u32 __key_curr, __key_prev;
@@ -0,0 +1,217 @@
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../source/math.h"
+
+// Checks the math functions against the engine's original versions, and against exact results
+
+int failures;
+
+#define CHECK(cond, ...)                               \
+	do {                                               \
+		if (!(cond) && failures++ < 20) {              \
+			printf("  %s:%d: ", __FILE__, __LINE__);   \
+			printf(__VA_ARGS__);                       \
+			printf("\n");                              \
+		}                                              \
+	} while (0)
+
+extern const int sine_table[91];
+
+// ---- Original versions ----
+
+// The loops only ever end up at angle mod 360, which this gets without taking forever on huge angles
+static int old_deg_sin(int angle) {
+	angle %= 360;
+	if (angle < 0)
+		angle += 360;
+
+	if (angle < 90)
+		return sine_table[angle];
+	else if (angle < 180)
+		return sine_table[180 - angle];
+	else if (angle < 270)
+		return -sine_table[angle - 180];
+	else
+		return -sine_table[360 - angle];
+}
+static AffineMatrix old_matrix_multiply(AffineMatrix b, AffineMatrix a) {
+	int x, y, i;
+
+	AffineMatrix ret;
+
+	int b_values[9];
+
+	for (x = 0; x < 6; ++x)
+		b_values[x] = b.values[x];
+
+	b_values[6] = 0;
+	b_values[7] = 0;
+	b_values[8] = 0x100;
+
+	for (x = 0; x < 3; ++x)
+		for (y = 0; y < 6; y += 3) {
+			ret.values[x + y] = 0;
+			for (i = 0; i < 3; ++i)
+				ret.values[x + y] += FIXED_MULT(a.values[i + y], b_values[x + (i * 3)]);
+		}
+
+	return ret;
+}
+
+static int same_matrix(AffineMatrix a, AffineMatrix b) {
+	int i;
+
+	for (i = 0; i < 6; ++i)
+		if (a.values[i] != b.values[i])
+			return 0;
+
+	return 1;
+}
+static AffineMatrix random_matrix() {
+	AffineMatrix m;
+	int i;
+
+	for (i = 0; i < 6; ++i)
+		m.values[i] = (rand() & 0x7FF) - 0x400;
+
+	return m;
+}
+
+// ---- Tests ----
+
+static void test_deg_sin() {
+	long long angle;
+
+	for (angle = -0x100000; angle <= 0x100000; ++angle) {
+		CHECK(int_deg_sin(angle) == old_deg_sin(angle), "int_deg_sin(%lld)", angle);
+		CHECK(int_deg_cos(angle) == old_deg_sin(angle + 90), "int_deg_cos(%lld)", angle);
+	}
+
+	// Either side of where the fast path would overflow
+	for (angle = -740000; angle <= -734000; ++angle)
+		CHECK(int_deg_sin(angle) == old_deg_sin(angle), "int_deg_sin(%lld)", angle);
+	for (angle = 734000; angle <= 740000; ++angle)
+		CHECK(int_deg_sin(angle) == old_deg_sin(angle), "int_deg_sin(%lld)", angle);
+
+	for (angle = INT_MIN; angle <= INT_MAX; angle += 65521)
+		CHECK(int_deg_sin(angle) == old_deg_sin(angle), "int_deg_sin(%lld)", angle);
+	for (angle = INT_MIN; angle < INT_MIN + 1000; ++angle)
+		CHECK(int_deg_sin(angle) == old_deg_sin(angle), "int_deg_sin(%lld)", angle);
+	for (angle = INT_MAX - 1000; angle <= INT_MAX; ++angle)
+		CHECK(int_deg_sin(angle) == old_deg_sin(angle), "int_deg_sin(%lld)", angle);
+}
+
+static void test_angle_sin() {
+	int i;
+
+	for (i = 0; i < ANGLE_STEPS; ++i) {
+		double exact = sin(i * 2 * M_PI / ANGLE_STEPS) * 0x100;
+
+		CHECK(fabs(ANGLE_SIN(i) - exact) <= 0.5, "ANGLE_SIN(%d) = %d, should be %f", i, ANGLE_SIN(i), exact);
+		CHECK(ANGLE_COS(i) == ANGLE_SIN(i + ANGLE_STEPS / 4), "ANGLE_COS(%d)", i);
+	}
+
+	// Same as the degree version, to one step of the binary angle
+	for (i = -36000; i <= 36000; ++i) {
+		double exact = i * (double)ANGLE_STEPS / 360;
+
+		CHECK(fabs(DEG2ANGLE(i) - exact) <= 1, "DEG2ANGLE(%d) = %d, should be %f", i, DEG2ANGLE(i), exact);
+	}
+}
+
+static void test_fixed_div() {
+	int a, b;
+
+	for (b = -0x4000; b <= 0x4000; b += 7) {
+		if (!b)
+			continue;
+
+		for (a = -0x8000; a <= 0x8000; a += 61) {
+			double exact = (double)a * 0x100 / b;
+
+			CHECK(fabs(fixed_div(a, b) - exact) <= 0.5, "fixed_div(%d, %d) = %d, should be %f", a, b, fixed_div(a, b), exact);
+		}
+
+		// Only as precise as the table
+		double exact = 65536.0 / b;
+
+		CHECK(fabs(fixed_reciprocal(b) - exact) < 1, "fixed_reciprocal(%d) = %d, should be %f", b, fixed_reciprocal(b), exact);
+	}
+
+	// Large numerators and small denominators, as long as the result still fits
+	for (b = 1; b < 0x100; ++b) {
+		for (a = 1; a < 0x7FFFFF / 0x100 * b && a < 0x7FFFFF; a = a * 3 + 1) {
+			double exact = (double)a * 0x100 / b;
+
+			CHECK(fabs(fixed_div(a, b) - exact) <= 0.5, "fixed_div(%d, %d) = %d, should be %f", a, b, fixed_div(a, b), exact);
+		}
+	}
+
+	CHECK(fixed_div(0x100, 0) == 0, "fixed_div by 0");
+	CHECK(fixed_reciprocal(0) == 0, "fixed_reciprocal of 0");
+}
+
+static void test_matrices() {
+	int i, j;
+
+	for (i = 0; i < 10000; ++i) {
+		AffineMatrix a = random_matrix(), b = random_matrix(), m;
+
+		CHECK(same_matrix(matrix_multiply(a, b), old_matrix_multiply(a, b)), "matrix_multiply");
+
+		int x = (rand() & 0xFFFF) - 0x8000, y = (rand() & 0xFFFF) - 0x8000;
+		m = a;
+		TRANSLATE_MATRIX(m, x, y);
+		CHECK(same_matrix(m, old_matrix_multiply(a, matrix_trans(x, y))), "TRANSLATE_MATRIX");
+
+		int r = (rand() & 0x3FF) - 0x200;
+		m = a;
+		ROTATE_MATRIX(m, r);
+		CHECK(same_matrix(m, old_matrix_multiply(a, matrix_rot(r))), "ROTATE_MATRIX");
+
+		m = a;
+		ROTATE_MATRIX_ANGLE(m, r);
+		CHECK(same_matrix(m, old_matrix_multiply(a, matrix_rot_angle(r))), "ROTATE_MATRIX_ANGLE");
+
+		int sx = (rand() & 0x3FF) - 0x200, sy = (rand() & 0x3FF) - 0x200;
+		m = a;
+		SCALE_MATRIX_XY(m, sx, sy);
+		CHECK(same_matrix(m, old_matrix_multiply(a, matrix_scale(sx, sy))), "SCALE_MATRIX_XY");
+
+		// A point moves the same as the translation of a matrix multiplied by it
+		int in[8], points[8], vectors[8];
+
+		for (j = 0; j < 8; ++j)
+			in[j] = points[j] = vectors[j] = (rand() & 0xFFFF) - 0x8000;
+
+		transform_points(&a, points, points, 4);
+		transform_vectors(&a, vectors, vectors, 4);
+
+		for (j = 0; j < 8; j += 2) {
+			m = old_matrix_multiply(matrix_trans(in[j], in[j + 1]), a);
+
+			CHECK(points[j] == m.values[2] && points[j + 1] == m.values[5], "transform_points");
+			CHECK(vectors[j] == m.values[2] - a.values[2] && vectors[j + 1] == m.values[5] - a.values[5], "transform_vectors");
+		}
+	}
+}
+
+int main() {
+	printf("math_test\n");
+
+	test_deg_sin();
+	test_angle_sin();
+	test_fixed_div();
+	test_matrices();
+
+	if (failures) {
+		printf("%d failed\n", failures);
+		return 1;
+	}
+
+	printf("passed\n");
+	return 0;
+}
@@ -0,0 +1,278 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../source/entities.h"
+#include "../source/math.h"
+#include "../source/physics.h"
+
+// Checks that physics_step_all moves every entity the same as calling entity_physics on each of them does, including
+// while entities are resting and the collision grid changes under them.  Also walks an entity up a slope and into a half
+// block, to check shapes push entities the way they should
+
+int failures;
+
+#define CHECK(cond, ...)                               \
+	do {                                               \
+		if (!(cond) && failures++ < 20) {              \
+			printf("  %s:%d: ", __FILE__, __LINE__);   \
+			printf(__VA_ARGS__);                       \
+			printf("\n");                              \
+		}                                              \
+	} while (0)
+
+// What the engine's other files would have defined
+Entity entities[ENTITY_LIMIT];
+unsigned int lvl_width, lvl_height;
+unsigned int game_life;
+u32 __key_curr, __key_prev;
+
+#define LEVEL_WIDTH	 40
+#define LEVEL_HEIGHT 30
+#define FRAMES		 600
+
+unsigned char grid[(LEVEL_WIDTH + 2) * (LEVEL_HEIGHT + 2)];
+
+// The compiler's SlopeUp and HalfBottom shapes
+unsigned char profiles[SHAPE_PROFILE_SIZE * 2];
+
+typedef struct {
+	int x, y, vel_x, vel_y;
+} EntityState;
+
+EntityState saved[ENTITY_LIMIT];
+unsigned int step_hits[ENTITY_LIMIT], each_hits[ENTITY_LIMIT];
+
+static void save_entities(EntityState* state) {
+	int i;
+
+	for (i = 0; i < ENTITY_LIMIT; ++i) {
+		state[i].x	   = ENT_X(i);
+		state[i].y	   = ENT_Y(i);
+		state[i].vel_x = ENT_VEL_X(i);
+		state[i].vel_y = ENT_VEL_Y(i);
+	}
+}
+static void load_entities(const EntityState* state) {
+	int i;
+
+	for (i = 0; i < ENTITY_LIMIT; ++i) {
+		ENT_X(i)	 = state[i].x;
+		ENT_Y(i)	 = state[i].y;
+		ENT_VEL_X(i) = state[i].vel_x;
+		ENT_VEL_Y(i) = state[i].vel_y;
+	}
+}
+
+static void make_profiles() {
+	int i;
+
+	for (i = 0; i < BLOCK_SIZE; ++i) {
+		unsigned char* slope = profiles;
+		unsigned char* half	 = profiles + SHAPE_PROFILE_SIZE;
+
+		// Slopes have no rows, so they're only pushed out of vertically
+		slope[PROFILE_TOP + i]	  = BLOCK_SIZE - 1 - i;
+		slope[PROFILE_BOTTOM + i] = BLOCK_SIZE;
+		slope[PROFILE_LEFT + i]	  = 0;
+		slope[PROFILE_RIGHT + i]  = 0;
+
+		half[PROFILE_TOP + i]	 = BLOCK_SIZE / 2;
+		half[PROFILE_BOTTOM + i] = BLOCK_SIZE;
+		half[PROFILE_LEFT + i]	 = 0;
+		half[PROFILE_RIGHT + i]	 = i < BLOCK_SIZE / 2 ? 0 : BLOCK_SIZE;
+	}
+
+	load_tile_shapes(profiles);
+}
+
+static int random_block() {
+	int r = rand() & 0x1F;
+
+	if (r < 3)
+		return COLLISION_VALUE(1, 0);
+	if (r == 3)
+		return COLLISION_VALUE(1, 1);
+	if (r == 4)
+		return COLLISION_VALUE(1, 2);
+	// Only hit by entities with the second bit in their hit mask
+	if (r == 5)
+		return COLLISION_VALUE(2, 0);
+	return 0;
+}
+
+static void make_level() {
+	int x, y;
+
+	lvl_width  = LEVEL_WIDTH;
+	lvl_height = LEVEL_HEIGHT;
+	reset_collision_grid(grid);
+
+	for (y = -1; y <= LEVEL_HEIGHT; ++y)
+		for (x = -1; x <= LEVEL_WIDTH; ++x) {
+			int edge = x < 1 || y < 1 || x >= LEVEL_WIDTH - 1 || y >= LEVEL_HEIGHT - 1;
+
+			COLLISION_AT(x, y) = edge ? COLLISION_VALUE(1, 0) : random_block();
+		}
+}
+
+static void make_entities() {
+	int i;
+
+	reset_entity_lists();
+
+	for (i = 0; i < ENTITY_LIMIT; ++i) {
+		ENT_X(i)	  = INT2FIXED(BLOCK_SIZE * 2 + rand() % (BLOCK_SIZE * (LEVEL_WIDTH - 6)));
+		ENT_Y(i)	  = INT2FIXED(BLOCK_SIZE * 2 + rand() % (BLOCK_SIZE * (LEVEL_HEIGHT - 6)));
+		ENT_VEL_X(i)  = (rand() & 0x3FF) - 0x200;
+		ENT_VEL_Y(i)  = (rand() & 0x3FF) - 0x200;
+		ENT_WIDTH(i)  = 4 + (rand() & 0x1F);
+		ENT_HEIGHT(i) = 4 + (rand() & 0x1F);
+
+		// A few entities are left unloaded, or active without physics
+		ENT_ID(i) = (i % 9) ? ENT_LOADED_FLAG | ENT_ACTIVE_FLAG : 0;
+		if (i % 5)
+			ENT_ID(i) |= ENT_COLLIDE_FLAG;
+
+		ENT_HIT_MASK(i) = (i & 3) ? 1 : 3;
+
+		refresh_entity(i);
+	}
+}
+
+static void record_hit(unsigned int index, unsigned int hits) {
+	step_hits[index] = hits;
+}
+
+// What the entities do between frames, so they speed up, come to rest and start moving again
+static void change_entities(int frame) {
+	int i;
+
+	for (i = 0; i < ENTITY_LIMIT; ++i) {
+		int r = rand() & 0xFF;
+
+		if (r < 16) {
+			ENT_VEL_X(i) = 0;
+			ENT_VEL_Y(i) = 0;
+		} else if (r < 20) {
+			ENT_VEL_X(i) = (rand() & 0x3FF) - 0x200;
+		} else if (r < 22) {
+			ENT_HIT_MASK(i) ^= 2;
+		} else if (r < 23) {
+			ENT_HEIGHT(i) = 4 + (rand() & 0x1F);
+		} else if (r < 64 && (i & 1)) {
+			// Falling, for the ones with gravity
+			ENT_VEL_Y(i) += 0x40;
+		}
+	}
+
+	// Every so often the level changes under them
+	if (frame % 37 == 0) {
+		int x = 1 + rand() % (LEVEL_WIDTH - 2), y = 1 + rand() % (LEVEL_HEIGHT - 2);
+
+		COLLISION_AT(x, y) = random_block();
+		collision_version++;
+	}
+}
+
+static void test_step_all() {
+	int frame, i, resting = 0;
+
+	for (frame = 0; frame < FRAMES; ++frame) {
+		EntityState stepped[ENTITY_LIMIT];
+
+		save_entities(saved);
+
+		memset(step_hits, 0, sizeof(step_hits));
+		physics_step_all(record_hit);
+		save_entities(stepped);
+
+		// The same frame again, one entity at a time
+		load_entities(saved);
+		memset(each_hits, 0, sizeof(each_hits));
+
+		for (i = 0; i < active_entities.count; ++i) {
+			int index = active_entities.items[i];
+
+			if (ENT_FLAG(COLLIDE, index))
+				each_hits[index] = entity_physics(&entities[index], ENT_HIT_MASK(index));
+		}
+
+		for (i = 0; i < ENTITY_LIMIT; ++i) {
+			CHECK(ENT_X(i) == stepped[i].x && ENT_Y(i) == stepped[i].y, "frame %d entity %d position: %x, %x should be %x, %x",
+				  frame, i, stepped[i].x, stepped[i].y, ENT_X(i), ENT_Y(i));
+			CHECK(ENT_VEL_X(i) == stepped[i].vel_x && ENT_VEL_Y(i) == stepped[i].vel_y, "frame %d entity %d velocity", frame, i);
+			CHECK(step_hits[i] == each_hits[i], "frame %d entity %d hits: %x should be %x", frame, i, step_hits[i], each_hits[i]);
+
+			resting += ENT_FLAG(COLLIDE, i) && !ENT_VEL_X(i) && !ENT_VEL_Y(i);
+		}
+
+		change_entities(frame);
+	}
+
+	// Make sure the resting shortcut was actually taken
+	CHECK(resting > FRAMES, "only %d resting entity steps", resting);
+}
+
+// A floor going up a slope onto a raised floor, with a half block on it.  An entity walking right climbs the slope and
+// stops against the half block
+static void test_slope() {
+	int x, y, frame;
+
+	lvl_width  = 20;
+	lvl_height = 10;
+	reset_collision_grid(grid);
+
+	for (y = -1; y <= 10; ++y)
+		for (x = -1; x <= 20; ++x)
+			COLLISION_AT(x, y) = (y >= 8 || (y == 7 && x >= 6)) ? COLLISION_VALUE(1, 0) : 0;
+
+	COLLISION_AT(5, 7)	= COLLISION_VALUE(1, 1);
+	COLLISION_AT(12, 6) = COLLISION_VALUE(1, 2);
+
+	ENT_X(0)	  = BLOCK2FIXED(2);
+	ENT_Y(0)	  = BLOCK2FIXED(8) - INT2FIXED(BLOCK_SIZE);
+	ENT_VEL_X(0)  = 0;
+	ENT_VEL_Y(0)  = 0;
+	ENT_WIDTH(0)  = BLOCK_SIZE - 4;
+	ENT_HEIGHT(0) = BLOCK_SIZE;
+
+	int lowest = ENT_Y(0);
+
+	for (frame = 0; frame < 240; ++frame) {
+		ENT_VEL_Y(0) += 0x40;
+		if (!ENT_VEL_X(0))
+			ENT_VEL_X(0) = 0x100;
+
+		entity_physics_at(0, 1);
+
+		// Never sinks into the floor or the slope
+		if (ENT_Y(0) > lowest)
+			lowest = ENT_Y(0);
+	}
+
+	CHECK(lowest == BLOCK2FIXED(8) - INT2FIXED(BLOCK_SIZE), "sank to %x", lowest);
+	CHECK(ENT_Y(0) == BLOCK2FIXED(7) - INT2FIXED(BLOCK_SIZE), "ended at y %x, should be on the raised floor", ENT_Y(0));
+	CHECK(ENT_X(0) + INT2FIXED(ENT_WIDTH(0)) == BLOCK2FIXED(12), "ended at x %x, should be against the half block", ENT_X(0));
+}
+
+int main() {
+	printf("physics_test\n");
+
+	srand(1);
+
+	make_profiles();
+	make_level();
+	make_entities();
+
+	test_step_all();
+	test_slope();
+
+	if (failures) {
+		printf("%d failed\n", failures);
+		return 1;
+	}
+
+	printf("passed\n");
+	return 0;
+}
@@ -3,8 +3,8 @@
 #define LARGE_TILES
 
 // The size of each individual save file.  Can be any size, but it is recommended it be a multiple of 16
-// The readable data in the save file will be one byte less than this number here.
-// The first byte is used to determine if a save file has been created or not
+// Every byte of it can be used.  Each save file is kept in two banks with an 8 byte header that has a CRC, so a save
+// that gets cut off goes back to the last good one.  A save file takes (SAVEFILE_LEN + 8) * 2 bytes of SRAM
 #define SAVEFILE_LEN		256
 
 // The size of the settings file.  Can be any size, but it is recommended it be a multiple of 16
@@ -16,6 +16,33 @@
 // The max amount of entities in the game at one time
 #define ENTITY_LIMIT 		16
 
+// Store entity positions, velocities, sizes and IDs in separate packed arrays instead of the Entity struct.
+// Faster to loop over, but entities must then be accessed with the ENT_ macros (ENT_X, ENT_DATA, etc.)
+// and passed to the engine by index (entity_physics_at, unload_entity_at)
+// #define ENTITY_SOA
+
+// Cycles entity updates can use each frame before entities with a slower update rate (LOAD_ENTITY_RATE) wait until next frame
+// #define ENTITY_UPDATE_BUDGET 160000
+
+// Size of the broadphase grid's cells as a shift (5 = 32 pixels).  Should be around the size of most entities
+// #define BROADPHASE_CELL_SHIFT 5
+
+// Let layers scroll by a different amount on each line of the screen (scanline.h), for multiple parallax bands on one
+// background layer.  Uses DMA channel 0 while any layer has offsets
+// #define SCANLINE_EFFECTS
+
+// Run the engine's hot paths (camera streaming, physics, particles, sprite animation) from IWRAM as ARM code.
+// Faster, but takes up IWRAM; the build prints how much is used.  Compare the profiler's phases with and without
+// #define IWRAM_HOT_PATHS
+
+// Time engine code when the game starts and print the cycle counts to the emulator's debug log (benchmark.h).  Build
+// with and without other options, like ENTITY_SOA, to compare them
+// #define PIXTRO_BENCHMARKS
+
+// The random number generator RNG() uses.  xoshiro128** by default, RNG_PCG32 is also available.
+// RNG_LEGACY is the original generator, kept for games that rely on its exact numbers.  It's much slower
+// #define RNG_PCG32
+
 #define RNG_SEED_1          0xFA12B4
 #define RNG_SEED_2          0x2B5C72
 #define RNG_SEED_3          0x14F4D2
\ No newline at end of file